@@ -0,0 +1,71 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <arith_uint256.h>
+#include <blockencodings.h>
+#include <consensus/merkle.h>
+#include <policy/policy.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <version.h>
+
+#include <vector>
+
+/* Number of transactions in the mempool blocks are reconstructed against */
+static const size_t RECONSTRUCT_MEMPOOL_SIZE = 100000;
+/* Every this many mempool transactions, one is in the block */
+static const size_t RECONSTRUCT_BLOCK_STRIDE = 50;
+
+// Reconstructs a compact block of 2000 transactions from a 100k transaction
+// mempool. The last transaction added to the mempool is in the block, so
+// every short ID of the mempool is computed.
+static void CompactBlockReconstruct(benchmark::State& state)
+{
+    CTxMemPool pool;
+    CBlock block;
+    block.nVersion = 4;
+    block.nBits = 0x1e0ffff0;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_1 << OP_1;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 50 * COIN;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    {
+        LOCK(pool.cs);
+        for (size_t i = 0; i < RECONSTRUCT_MEMPOOL_SIZE; i++) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = COutPoint(ArithToUint256(arith_uint256(i + 1)), 0);
+            tx.vin[0].scriptSig = CScript() << OP_1;
+            tx.vout.resize(1);
+            tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+            tx.vout[0].nValue = COIN;
+            CTransactionRef ptx = MakeTransactionRef(tx);
+            pool.addUnchecked(ptx->GetHash(), CTxMemPoolEntry(ptx, 1000, 0, 1, false, 4, LockPoints()));
+            if (i % RECONSTRUCT_BLOCK_STRIDE == RECONSTRUCT_BLOCK_STRIDE - 1)
+                block.vtx.push_back(ptx);
+        }
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    CBlockHeaderAndShortTxIDs cmpctblock(block, false);
+    // Round-trip to fill in the short ID selector as a received block would
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << cmpctblock;
+    CBlockHeaderAndShortTxIDs received;
+    stream >> received;
+
+    const std::vector<std::pair<uint256, CTransactionRef>> extra_txn;
+    while (state.KeepRunning()) {
+        PartiallyDownloadedBlock partial(&pool);
+        bool ok = partial.InitData(received, extra_txn) == READ_STATUS_OK;
+        assert(ok);
+        assert(partial.IsTxAvailable(block.vtx.size() - 1));
+    }
+}
+
+BENCHMARK(CompactBlockReconstruct, 20);
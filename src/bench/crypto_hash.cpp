@@ -11,6 +11,7 @@
 #include <uint256.h>
 #include <utiltime.h>
 #include <crypto/ripemd160.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
@@ -69,6 +70,24 @@ static void SipHash_32b(benchmark::State& state)
     }
 }
 
+/* Number of values to hash per batched SipHash iteration */
+static const size_t SIPHASH_BATCH = 64;
+
+static void SipHash_batch_64x32b(benchmark::State& state)
+{
+    std::vector<uint256> in(SIPHASH_BATCH);
+    std::vector<const uint256*> ptrs(SIPHASH_BATCH);
+    for (size_t i = 0; i < SIPHASH_BATCH; i++) {
+        *((uint64_t*)in[i].begin()) = i;
+        ptrs[i] = &in[i];
+    }
+    std::vector<uint64_t> out(SIPHASH_BATCH);
+    uint64_t k1 = 0;
+    while (state.KeepRunning()) {
+        SipHashUint256Batch(0, ++k1, ptrs.data(), SIPHASH_BATCH, out.data());
+    }
+}
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -87,6 +106,30 @@ static void FastRandom_1bit(benchmark::State& state)
     }
 }
 
+/* Number of 80-byte headers to hash per scrypt iteration */
+static const size_t SCRYPT_HEADERS = 16;
+
+static void Scrypt_16x80b(benchmark::State& state)
+{
+    std::vector<char> in(SCRYPT_HEADERS * 80, 0);
+    std::vector<char> out(SCRYPT_HEADERS * 32);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < SCRYPT_HEADERS; i++)
+            scrypt_1024_1_1_256(in.data() + i * 80, out.data() + i * 32);
+    }
+}
+
+static void Scrypt_multi_16x80b(benchmark::State& state)
+{
+#if defined(USE_SSE2)
+    (void) scrypt_detect_sse2();
+#endif
+    std::vector<char> in(SCRYPT_HEADERS * 80, 0);
+    std::vector<char> out(SCRYPT_HEADERS * 32);
+    while (state.KeepRunning())
+        scrypt_1024_1_1_256_multi(in.data(), out.data(), SCRYPT_HEADERS);
+}
+
 BENCHMARK(RIPEMD160, 440);
 BENCHMARK(SHA1, 570);
 BENCHMARK(SHA256, 340);
@@ -94,5 +137,9 @@ BENCHMARK(SHA512, 330);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
+BENCHMARK(SipHash_batch_64x32b, 1000 * 1000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
+
+BENCHMARK(Scrypt_16x80b, 10);
+BENCHMARK(Scrypt_multi_16x80b, 10);
@@ -111,4 +111,38 @@ static void MempoolEviction(benchmark::State& state)
     }
 }
 
+// Evicts a long chain of transactions in one go. Fees grow along the chain,
+// so the first transaction has the lowest descendant score and the whole
+// chain is removed as a single package.
+static void MempoolEvictionChain(benchmark::State& state)
+{
+    const int nChainLength = 500;
+    std::vector<CTransactionRef> chain;
+    uint256 prevHash;
+    for (int i = 0; i < nChainLength; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        if (i == 0) {
+            tx.vin[0].scriptSig = CScript() << OP_1;
+        } else {
+            tx.vin[0].prevout = COutPoint(prevHash, 0);
+        }
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        chain.push_back(MakeTransactionRef(tx));
+        prevHash = chain.back()->GetHash();
+    }
+
+    CTxMemPool pool;
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < nChainLength; i++) {
+            AddTx(*chain[i], 1000LL + i, pool);
+        }
+        pool.TrimToSize(0);
+    }
+}
+
 BENCHMARK(MempoolEviction, 41000);
+BENCHMARK(MempoolEvictionChain, 20);
@@ -151,6 +151,8 @@ public:
     CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID);
 
     uint64_t GetShortID(const uint256& txhash) const;
+    /** GetShortID of count hashes at once */
+    void GetShortIDs(const uint256* const* txhashes, size_t count, uint64_t* shortids) const;
 
     size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
 
@@ -191,6 +193,42 @@ public:
     }
 };
 
+/**
+ * Flat open-addressing table from the short IDs of a compact block to the
+ * positions of their transactions. Each slot packs the 48-bit short ID into
+ * the high bits and the position plus one into the low 16 bits, so empty
+ * slots are zero for every short ID and most lookups touch one cache line.
+ */
+class ShortTxIDTable
+{
+protected:
+    std::vector<uint64_t> slots;
+    size_t mask;
+
+public:
+    /**
+     * The table is kept at most a quarter full. Short IDs of a well-formed
+     * compact block are uniformly distributed, and linear probing then
+     * needs more than MAX_PROBES probes to insert one of 16000 of them far
+     * less than once per million block transfers. Anything worse is
+     * treated as READ_STATUS_FAILED. As no short ID is stored further than
+     * MAX_PROBES from its home slot, lookups stop there too, even in a long
+     * run of short IDs that a peer placed in consecutive home slots.
+     */
+    static const size_t MAX_PROBES = 48;
+
+    explicit ShortTxIDTable(size_t count);
+
+    /**
+     * Returns false if shortid is already in the table, its probe sequence
+     * is too long, or index does not fit in a slot
+     */
+    bool Insert(uint64_t shortid, size_t index);
+
+    /** Position of the transaction with shortid, or -1 */
+    int Find(uint64_t shortid) const;
+};
+
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
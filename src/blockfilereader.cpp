@@ -0,0 +1,229 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilereader.h>
+
+#include <clientversion.h>
+#include <consensus/consensus.h>
+#include <crypto/common.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileReader g_block_file_reader;
+
+namespace {
+
+/** Walks serialized data, appending the parts that are kept to out */
+class StripCursor
+{
+private:
+    const unsigned char* p;
+    const unsigned char* const pend;
+    std::vector<unsigned char>& out;
+
+public:
+    StripCursor(const unsigned char* pbegin, const unsigned char* pendIn, std::vector<unsigned char>& outIn) :
+        p(pbegin), pend(pendIn), out(outIn) {}
+
+    bool AtEnd() const { return p == pend; }
+
+    bool Skip(size_t n, bool fKeep)
+    {
+        if ((size_t)(pend - p) < n)
+            return false;
+        if (fKeep)
+            out.insert(out.end(), p, p + n);
+        p += n;
+        return true;
+    }
+
+    bool CompactSize(uint64_t& n, bool fKeep)
+    {
+        if (p == pend)
+            return false;
+        const unsigned char* pstart = p;
+        size_t nBytes = *p < 253 ? 0 : *p == 253 ? 2 : *p == 254 ? 4 : 8;
+        if ((size_t)(pend - p) < 1 + nBytes)
+            return false;
+        n = nBytes == 0 ? *p : nBytes == 2 ? ReadLE16(p + 1) : nBytes == 4 ? ReadLE32(p + 1) : ReadLE64(p + 1);
+        p += 1 + nBytes;
+        if (fKeep)
+            out.insert(out.end(), pstart, p);
+        return true;
+    }
+
+    /** A length prefixed byte vector, such as a script or a witness stack item */
+    bool Bytes(bool fKeep)
+    {
+        uint64_t n;
+        return CompactSize(n, fKeep) && Skip(n, fKeep);
+    }
+
+    bool Inputs(uint64_t& nIn)
+    {
+        if (!CompactSize(nIn, true))
+            return false;
+        for (uint64_t i = 0; i < nIn; i++) {
+            if (!Skip(36, true) || !Bytes(true) || !Skip(4, true))
+                return false;
+        }
+        return true;
+    }
+
+    bool Outputs()
+    {
+        uint64_t nOut;
+        if (!CompactSize(nOut, true))
+            return false;
+        for (uint64_t i = 0; i < nOut; i++) {
+            if (!Skip(8, true) || !Bytes(true))
+                return false;
+        }
+        return true;
+    }
+
+    /** Mirrors UnserializeTransaction */
+    bool Transaction()
+    {
+        if (!Skip(4, true))
+            return false;
+        uint64_t nIn;
+        unsigned char flags = 0;
+        if (!Inputs(nIn))
+            return false;
+        if (nIn == 0) {
+            // An empty vin or the witness marker
+            if (p == pend)
+                return false;
+            flags = *p++;
+            if (flags != 0) {
+                out.pop_back();
+                if (!Inputs(nIn) || !Outputs())
+                    return false;
+            } else {
+                // It was the empty vout of a transaction without inputs
+                out.push_back(0);
+            }
+        } else if (!Outputs()) {
+            return false;
+        }
+        if (flags & 1) {
+            flags ^= 1;
+            for (uint64_t i = 0; i < nIn; i++) {
+                uint64_t nItems;
+                if (!CompactSize(nItems, false))
+                    return false;
+                for (uint64_t j = 0; j < nItems; j++) {
+                    if (!Bytes(false))
+                        return false;
+                }
+            }
+        }
+        return flags == 0 && Skip(4, true);
+    }
+};
+
+} // namespace
+
+bool CRawBlock::GetWithoutWitness(std::vector<unsigned char>& out) const
+{
+    out.clear();
+    out.reserve(nSize);
+    StripCursor cursor(begin(), end(), out);
+    uint64_t nTx;
+    if (!cursor.Skip(80, true) || !cursor.CompactSize(nTx, true))
+        return false;
+    for (uint64_t i = 0; i < nTx; i++) {
+        if (!cursor.Transaction())
+            return false;
+    }
+    return cursor.AtEnd();
+}
+
+bool CBlockFileReader::GetMapping(int nFile, size_t nMinSize, Mapping& mapping)
+{
+#ifndef WIN32
+    std::lock_guard<std::mutex> lock(cs);
+    auto it = mapFiles.find(nFile);
+    if (it != mapFiles.end() && it->second.nSize >= nMinSize) {
+        mapping = it->second;
+        return true;
+    }
+
+    int fd = open(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk").string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (size_t)st.st_size < nMinSize) {
+        close(fd);
+        return false;
+    }
+    const size_t nSize = st.st_size;
+    void* addr = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    if (it == mapFiles.end() && mapFiles.size() >= MAX_BLOCK_FILE_MAPPINGS) {
+        // The lowest numbered files hold the oldest blocks
+        mapFiles.erase(mapFiles.begin());
+    }
+    mapping.data = std::shared_ptr<const void>(addr, [nSize](const void* p) { munmap(const_cast<void*>(p), nSize); });
+    mapping.nSize = nSize;
+    mapFiles[nFile] = mapping;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CBlockFileReader::Read(const CDiskBlockPos& pos, CRawBlock& raw)
+{
+    if (pos.IsNull() || pos.nPos < sizeof(uint32_t))
+        return false;
+
+    // The whole address space of a 32-bit process is too small to keep block files mapped
+    Mapping mapping;
+    if (sizeof(void*) >= 8 && fMapFiles && GetMapping(pos.nFile, pos.nPos, mapping)) {
+        uint32_t nSize = ReadLE32((const unsigned char*)mapping.data.get() + pos.nPos - sizeof(uint32_t));
+        if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return false;
+        if (pos.nPos + nSize > mapping.nSize && !GetMapping(pos.nFile, pos.nPos + nSize, mapping))
+            return false;
+        raw = CRawBlock(mapping.data, (const unsigned char*)mapping.data.get() + pos.nPos, nSize);
+        return true;
+    }
+
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(uint32_t)), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    uint32_t nSize;
+    try {
+        filein >> nSize;
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+        return false;
+    auto buf = std::make_shared<std::vector<unsigned char>>(nSize);
+    if (nSize > 0 && fread(buf->data(), 1, nSize, filein.Get()) != nSize)
+        return false;
+    raw = CRawBlock(buf, buf->data(), nSize);
+    return true;
+}
+
+void CBlockFileReader::Forget(int nFile)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    mapFiles.erase(nFile);
+}
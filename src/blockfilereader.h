@@ -0,0 +1,98 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEREADER_H
+#define BITCOIN_BLOCKFILEREADER_H
+
+#include <chain.h>
+
+#include <stddef.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** Maximum number of block files kept mapped at once */
+static const size_t MAX_BLOCK_FILE_MAPPINGS = 64;
+/** Default for -blockmmap */
+static const bool DEFAULT_BLOCK_MMAP = false;
+
+/**
+ * The serialized bytes of a block as stored in a block file. The bytes
+ * stay valid for as long as the CRawBlock, or a copy of it, is alive.
+ */
+class CRawBlock
+{
+public:
+    CRawBlock() : pbegin(nullptr), nSize(0) {}
+    CRawBlock(std::shared_ptr<const void> holderIn, const unsigned char* pbeginIn, size_t nSizeIn) :
+        holder(std::move(holderIn)), pbegin(pbeginIn), nSize(nSizeIn) {}
+
+    const unsigned char* begin() const { return pbegin; }
+    const unsigned char* end() const { return pbegin + nSize; }
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    /**
+     * Serialize the block without witnesses into out, copying everything
+     * but the witness markers and stacks in a single pass over the bytes.
+     * Returns false if the bytes don't parse as a block.
+     */
+    bool GetWithoutWitness(std::vector<unsigned char>& out) const;
+
+private:
+    //! Keeps the mapping or buffer the bytes live in alive
+    std::shared_ptr<const void> holder;
+    const unsigned char* pbegin;
+    size_t nSize;
+};
+
+/**
+ * Reads the serialized bytes of blocks out of the block files, so that a
+ * block is only deserialized where its structure is needed.
+ *
+ * By default each block is read into a buffer of its own, and a read error
+ * or a truncated file fails the read. With -blockmmap, blocks are handed
+ * out of read-only memory maps of the block files without copying them. A
+ * file is then mapped as a whole when a block is first read from it, and
+ * mapped again when a block beyond the end of the mapping is asked for
+ * because the file has grown. Replaced mappings are unmapped once the
+ * last CRawBlock pointing into them is gone. An I/O error on a mapped page,
+ * or a file truncated while mapped, raises SIGBUS and terminates the
+ * process, which is why mapping is opt-in. Platforms without mmap always
+ * read into buffers.
+ */
+class CBlockFileReader
+{
+public:
+    CBlockFileReader() : fMapFiles(DEFAULT_BLOCK_MMAP) {}
+
+    /** Whether blocks are read through memory maps of the block files */
+    void SetMapFiles(bool fMapFilesIn) { fMapFiles = fMapFilesIn; }
+
+    /** Read the block stored at pos, which points just past its size prefix */
+    bool Read(const CDiskBlockPos& pos, CRawBlock& raw);
+    /** Drop the mapping of a block file, e.g. because it is being deleted */
+    void Forget(int nFile);
+
+private:
+    struct Mapping
+    {
+        std::shared_ptr<const void> data;
+        size_t nSize;
+    };
+
+    std::atomic<bool> fMapFiles;
+    std::mutex cs;
+    //! Mappings by file number, guarded by cs
+    std::map<int, Mapping> mapFiles;
+
+    /** Get a mapping of block file nFile that is at least nMinSize bytes long */
+    bool GetMapping(int nFile, size_t nMinSize, Mapping& mapping);
+};
+
+extern CBlockFileReader g_block_file_reader;
+
+#endif // BITCOIN_BLOCKFILEREADER_H
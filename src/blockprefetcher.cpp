@@ -0,0 +1,162 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockprefetcher.h>
+
+#include <blockfilereader.h>
+#include <clientversion.h>
+#include <pow.h>
+#include <streams.h>
+#include <txdb.h>
+#include <txmempool.h>
+#include <util.h>
+
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+
+std::unique_ptr<CBlockPrefetcher> g_block_prefetcher;
+
+CBlockPrefetcher::CBlockPrefetcher(const CCoinsViewDB* pcoinsdbIn, const Consensus::Params& consensusParamsIn, int nBlocksIn, int nThreads) :
+    pcoinsdb(pcoinsdbIn), consensusParams(consensusParamsIn), nBlocks(nBlocksIn), fStop(false)
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()> >, "prefetch", std::function<void()>(std::bind(&CBlockPrefetcher::ThreadPrefetch, this)));
+    }
+}
+
+CBlockPrefetcher::~CBlockPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    condWork.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void CBlockPrefetcher::Prefetch(const std::vector<Request>& vRequests)
+{
+    std::vector<std::shared_ptr<Entry>> vNew;
+    bool fQueued = false;
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        for (const Request& req : vRequests) {
+            if ((int)vNew.size() >= nBlocks)
+                break;
+            auto it = std::find_if(vEntries.begin(), vEntries.end(), [&req](const std::shared_ptr<Entry>& entry) { return entry->req.hash == req.hash; });
+            if (it != vEntries.end()) {
+                vNew.push_back(*it);
+            } else {
+                vNew.push_back(std::make_shared<Entry>(req));
+                fQueued = true;
+            }
+        }
+        // Entries being read when they are dropped are let go by their thread
+        vEntries.swap(vNew);
+    }
+    if (fQueued)
+        condWork.notify_all();
+}
+
+bool CBlockPrefetcher::Take(const uint256& hash, std::shared_ptr<const CBlock>& pblock, CCoinsViewCache& view)
+{
+    std::shared_ptr<Entry> entry;
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        auto it = std::find_if(vEntries.begin(), vEntries.end(), [&hash](const std::shared_ptr<Entry>& e) { return e->req.hash == hash; });
+        if (it == vEntries.end())
+            return false;
+        entry = *it;
+        vEntries.erase(it);
+        if (entry->state == Entry::QUEUED)
+            return false;
+        condDone.wait(lock, [&entry] { return entry->state == Entry::DONE; });
+    }
+    if (!entry->pblock)
+        return false;
+
+    pblock = entry->pblock;
+    // Coins missing from the cache are as the database holds them, which
+    // is what they were read as if no write to the database was under way
+    // while they were read, nor has been since
+    if (entry->nCoinsWrites % 2 == 0 && entry->nCoinsWrites == pcoinsdb->GetWriteCount()) {
+        for (auto& coin : entry->vCoins) {
+            view.PreloadCoin(coin.first, std::move(coin.second));
+        }
+    }
+    return true;
+}
+
+bool CBlockPrefetcher::WaitForRead(const uint256& hash)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    auto it = std::find_if(vEntries.begin(), vEntries.end(), [&hash](const std::shared_ptr<Entry>& e) { return e->req.hash == hash; });
+    if (it == vEntries.end())
+        return false;
+    std::shared_ptr<Entry> entry = *it;
+    condDone.wait(lock, [&entry] { return entry->state == Entry::DONE; });
+    return true;
+}
+
+void CBlockPrefetcher::ThreadPrefetch()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        std::vector<std::shared_ptr<Entry>>::iterator it;
+        condWork.wait(lock, [this, &it] {
+            it = std::find_if(vEntries.begin(), vEntries.end(), [](const std::shared_ptr<Entry>& entry) { return entry->state == Entry::QUEUED; });
+            return fStop || it != vEntries.end();
+        });
+        if (fStop)
+            return;
+        std::shared_ptr<Entry> entry = *it;
+        entry->state = Entry::READING;
+        lock.unlock();
+
+        Read(*entry);
+
+        lock.lock();
+        entry->state = Entry::DONE;
+        condDone.notify_all();
+    }
+}
+
+void CBlockPrefetcher::Read(Entry& entry) const
+{
+    CRawBlock raw;
+    if (!g_block_file_reader.Read(entry.req.pos, raw))
+        return;
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    try {
+        CSpanReader(SER_DISK, CLIENT_VERSION, raw.begin(), raw.end()) >> *pblock;
+    } catch (const std::exception&) {
+        return;
+    }
+
+    // The same checks as ReadBlockFromDisk, which is left to report failures
+    if (pblock->GetHash() != entry.req.hash)
+        return;
+    uint256 hashPoW = entry.req.hashPoW.IsNull() ? pblock->GetPoWHash() : entry.req.hashPoW;
+    if (!CheckProofOfWork(hashPoW, pblock->nBits, consensusParams))
+        return;
+
+    // Outputs created within the block are not in the database yet
+    std::unordered_set<uint256, SaltedTxidHasher> setTxids;
+    for (const CTransactionRef& tx : pblock->vtx) {
+        setTxids.insert(tx->GetHash());
+    }
+    entry.nCoinsWrites = pcoinsdb->GetWriteCount();
+    for (const CTransactionRef& tx : pblock->vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            Coin coin;
+            if (!setTxids.count(txin.prevout.hash) && pcoinsdb->GetCoin(txin.prevout, coin) && !coin.IsSpent())
+                entry.vCoins.emplace_back(txin.prevout, std::move(coin));
+        }
+    }
+    entry.pblock = std::move(pblock);
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKPREFETCHER_H
+#define BITCOIN_BLOCKPREFETCHER_H
+
+#include <chain.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class CCoinsViewDB;
+
+/** Default for -blockprefetch, the number of blocks read ahead of the one being connected */
+static const int DEFAULT_BLOCK_PREFETCH = 16;
+/** Maximum for -blockprefetch */
+static const int MAX_BLOCK_PREFETCH = 256;
+/** Number of threads reading blocks ahead */
+static const int BLOCK_PREFETCH_THREADS = 2;
+
+/**
+ * Reads the blocks that are about to be connected ahead of time on threads
+ * of its own, so that connecting a block doesn't wait for it to be read and
+ * deserialized. Along with each block it reads the coins its inputs spend
+ * from the coins database, which brings them into memory for the cache.
+ */
+class CBlockPrefetcher
+{
+public:
+    /** What is needed to read a block without looking at its index entry */
+    struct Request
+    {
+        uint256 hash;
+        CDiskBlockPos pos;
+        //! Scrypt hash of the header if it is known, null otherwise
+        uint256 hashPoW;
+    };
+
+    CBlockPrefetcher(const CCoinsViewDB* pcoinsdbIn, const Consensus::Params& consensusParamsIn, int nBlocksIn, int nThreads);
+    ~CBlockPrefetcher();
+
+    /**
+     * Read the first nBlocks of the requested blocks ahead, in the order
+     * given. Blocks from earlier calls that are not requested any more are
+     * dropped.
+     */
+    void Prefetch(const std::vector<Request>& vRequests);
+
+    /**
+     * Take a block that was requested out of the prefetcher, waiting for it
+     * if it is being read. The coins read along with it are added to view,
+     * unless the coins database was written to while or after they were
+     * read. Returns false if the block wasn't read, or not yet started on,
+     * in which case the caller has to read it itself.
+     *
+     * view must be a cache on top of the coins database, and must not be
+     * flushed between Prefetch and Take other than through BatchWrite.
+     */
+    bool Take(const uint256& hash, std::shared_ptr<const CBlock>& pblock, CCoinsViewCache& view);
+
+    /**
+     * Wait until a requested block has been read, false if it isn't
+     * requested. The block must stay requested meanwhile. Used by tests.
+     */
+    bool WaitForRead(const uint256& hash);
+
+private:
+    struct Entry
+    {
+        enum State { QUEUED, READING, DONE };
+
+        Request req;
+        State state;
+        //! Null if the block could not be read
+        std::shared_ptr<const CBlock> pblock;
+        std::vector<std::pair<COutPoint, Coin>> vCoins;
+        //! Write count of the coins database before vCoins were read, see CCoinsViewDB::GetWriteCount
+        uint64_t nCoinsWrites;
+
+        explicit Entry(const Request& reqIn) : req(reqIn), state(QUEUED), nCoinsWrites(0) {}
+    };
+
+    const CCoinsViewDB* pcoinsdb;
+    const Consensus::Params& consensusParams;
+    const int nBlocks;
+
+    std::mutex cs;
+    //! Signalled when a block is requested or the prefetcher is shutting down
+    std::condition_variable condWork;
+    //! Signalled when a block has been read
+    std::condition_variable condDone;
+    //! Requested blocks in the order they will be connected, guarded by cs
+    std::vector<std::shared_ptr<Entry>> vEntries;
+    bool fStop;
+    std::vector<std::thread> threads;
+
+    void ThreadPrefetch();
+    /** Read the block and the coins of an entry in state READING */
+    void Read(Entry& entry) const;
+};
+
+extern std::unique_ptr<CBlockPrefetcher> g_block_prefetcher;
+
+#endif // BITCOIN_BLOCKPREFETCHER_H
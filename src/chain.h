@@ -219,6 +219,10 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    //! Scrypt proof-of-work hash of the header, recorded once it has been checked.
+    //! Null if not known yet. Stored in the block tree DB next to the index entry.
+    uint256 hashPoW;
+
     void SetNull()
     {
         phashBlock = nullptr;
@@ -234,6 +238,7 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        hashPoW = uint256();
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -296,6 +301,8 @@ public:
 
     uint256 GetBlockPoWHash() const
     {
+        if (!hashPoW.IsNull())
+            return hashPoW;
         return GetBlockHeader().GetPoWHash();
     }
 
@@ -216,6 +216,24 @@ void CCoinsViewCache::Uncache(const COutPoint& hash)
     }
 }
 
+void CCoinsViewCache::ForEachCachedCoin(const std::function<void(const COutPoint&, const Coin&)>& fn) const
+{
+    for (const auto& entry : cacheCoins) {
+        if (!entry.second.coin.IsSpent())
+            fn(entry.first, entry.second.coin);
+    }
+}
+
+bool CCoinsViewCache::PreloadCoin(const COutPoint& outpoint, Coin&& coin)
+{
+    assert(!coin.IsSpent());
+    auto inserted = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (!inserted.second)
+        return false;
+    cachedCoinsUsage += inserted.first->second.coin.DynamicMemoryUsage();
+    return true;
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -15,6 +15,7 @@
 #include <uint256.h>
 
 #include <assert.h>
+#include <functional>
 #include <stdint.h>
 
 #include <unordered_map>
@@ -274,6 +275,19 @@ public:
      */
     void Uncache(const COutPoint &outpoint);
 
+    /**
+     * Call fn for every unspent coin held in this cache, modified or not.
+     * fn must not modify the cache.
+     */
+    void ForEachCachedCoin(const std::function<void(const COutPoint&, const Coin&)>& fn) const;
+
+    /**
+     * Add an unmodified coin that is known to match the backing view, such as
+     * one read back from a snapshot of an earlier cache. Does nothing and
+     * returns false if the outpoint is already cached.
+     */
+    bool PreloadCoin(const COutPoint& outpoint, Coin&& coin);
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
@@ -137,4 +137,189 @@ void scrypt_1024_1_1_256_sp_sse2(const char *input, char *output, char *scratchp
 	PBKDF2_SHA256((const uint8_t *)input, 80, B, 128, 1, (uint8_t *)output, 32);
 }
 
+/*
+ * Multi-buffer variants: hash several independent 80-byte inputs at once
+ * with each hash occupying one 32-bit lane of the vector registers. The
+ * scratchpad of lane l holds word k of entry i at V[i * 32 + k] lane l.
+ */
+#define SALSA_STEP_4WAY(d, a, b, r) \
+	d = _mm_xor_si128(d, _mm_or_si128(_mm_slli_epi32(_mm_add_epi32(a, b), r), _mm_srli_epi32(_mm_add_epi32(a, b), 32 - r)))
+
+static inline void xor_salsa8_4way(__m128i B[16], const __m128i Bx[16])
+{
+	__m128i x[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] = _mm_xor_si128(B[i], Bx[i]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on columns. */
+		SALSA_STEP_4WAY(x[ 4], x[ 0], x[12],  7);  SALSA_STEP_4WAY(x[ 9], x[ 5], x[ 1],  7);
+		SALSA_STEP_4WAY(x[14], x[10], x[ 6],  7);  SALSA_STEP_4WAY(x[ 3], x[15], x[11],  7);
+
+		SALSA_STEP_4WAY(x[ 8], x[ 4], x[ 0],  9);  SALSA_STEP_4WAY(x[13], x[ 9], x[ 5],  9);
+		SALSA_STEP_4WAY(x[ 2], x[14], x[10],  9);  SALSA_STEP_4WAY(x[ 7], x[ 3], x[15],  9);
+
+		SALSA_STEP_4WAY(x[12], x[ 8], x[ 4], 13);  SALSA_STEP_4WAY(x[ 1], x[13], x[ 9], 13);
+		SALSA_STEP_4WAY(x[ 6], x[ 2], x[14], 13);  SALSA_STEP_4WAY(x[11], x[ 7], x[ 3], 13);
+
+		SALSA_STEP_4WAY(x[ 0], x[12], x[ 8], 18);  SALSA_STEP_4WAY(x[ 5], x[ 1], x[13], 18);
+		SALSA_STEP_4WAY(x[10], x[ 6], x[ 2], 18);  SALSA_STEP_4WAY(x[15], x[11], x[ 7], 18);
+
+		/* Operate on rows. */
+		SALSA_STEP_4WAY(x[ 1], x[ 0], x[ 3],  7);  SALSA_STEP_4WAY(x[ 6], x[ 5], x[ 4],  7);
+		SALSA_STEP_4WAY(x[11], x[10], x[ 9],  7);  SALSA_STEP_4WAY(x[12], x[15], x[14],  7);
+
+		SALSA_STEP_4WAY(x[ 2], x[ 1], x[ 0],  9);  SALSA_STEP_4WAY(x[ 7], x[ 6], x[ 5],  9);
+		SALSA_STEP_4WAY(x[ 8], x[11], x[10],  9);  SALSA_STEP_4WAY(x[13], x[12], x[15],  9);
+
+		SALSA_STEP_4WAY(x[ 3], x[ 2], x[ 1], 13);  SALSA_STEP_4WAY(x[ 4], x[ 7], x[ 6], 13);
+		SALSA_STEP_4WAY(x[ 9], x[ 8], x[11], 13);  SALSA_STEP_4WAY(x[14], x[13], x[12], 13);
+
+		SALSA_STEP_4WAY(x[ 0], x[ 3], x[ 2], 18);  SALSA_STEP_4WAY(x[ 5], x[ 4], x[ 7], 18);
+		SALSA_STEP_4WAY(x[10], x[ 9], x[ 8], 18);  SALSA_STEP_4WAY(x[15], x[14], x[13], 18);
+	}
+
+	for (i = 0; i < 16; i++)
+		B[i] = _mm_add_epi32(B[i], x[i]);
+}
+
+void scrypt_1024_1_1_256_sp_sse2_4way(const char *input, char *output, char *scratchpad)
+{
+	uint8_t B[4][128];
+	union {
+		__m128i i128[32];
+		uint32_t u32[32][4];
+	} X;
+	__m128i *V;
+	uint32_t i, j, k, l;
+
+	V = (__m128i *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
+
+	for (l = 0; l < 4; l++) {
+		PBKDF2_SHA256((const uint8_t *)input + l * 80, 80, (const uint8_t *)input + l * 80, 80, 1, B[l], 128);
+		for (k = 0; k < 32; k++)
+			X.u32[k][l] = le32dec(&B[l][4 * k]);
+	}
+
+	for (i = 0; i < 1024; i++) {
+		for (k = 0; k < 32; k++)
+			V[i * 32 + k] = X.i128[k];
+		xor_salsa8_4way(&X.i128[0], &X.i128[16]);
+		xor_salsa8_4way(&X.i128[16], &X.i128[0]);
+	}
+	for (i = 0; i < 1024; i++) {
+		const uint32_t *V32 = (const uint32_t *)V;
+		uint32_t jl[4];
+		for (l = 0; l < 4; l++)
+			jl[l] = 32 * 4 * (X.u32[16][l] & 1023) + l;
+		for (k = 0; k < 32; k++) {
+			j = 4 * k;
+			X.i128[k] = _mm_xor_si128(X.i128[k], _mm_set_epi32(V32[jl[3] + j], V32[jl[2] + j], V32[jl[1] + j], V32[jl[0] + j]));
+		}
+		xor_salsa8_4way(&X.i128[0], &X.i128[16]);
+		xor_salsa8_4way(&X.i128[16], &X.i128[0]);
+	}
+
+	for (l = 0; l < 4; l++) {
+		for (k = 0; k < 32; k++)
+			le32enc(&B[l][4 * k], X.u32[k][l]);
+		PBKDF2_SHA256((const uint8_t *)input + l * 80, 80, B[l], 128, 1, (uint8_t *)output + l * 32, 32);
+	}
+}
+
+#if defined(USE_SCRYPT_AVX2)
+#include <immintrin.h>
+
+#define SALSA_STEP_8WAY(d, a, b, r) \
+	d = _mm256_xor_si256(d, _mm256_or_si256(_mm256_slli_epi32(_mm256_add_epi32(a, b), r), _mm256_srli_epi32(_mm256_add_epi32(a, b), 32 - r)))
+
+__attribute__((target("avx2")))
+static inline void xor_salsa8_8way(__m256i B[16], const __m256i Bx[16])
+{
+	__m256i x[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		x[i] = B[i] = _mm256_xor_si256(B[i], Bx[i]);
+
+	for (i = 0; i < 8; i += 2) {
+		/* Operate on columns. */
+		SALSA_STEP_8WAY(x[ 4], x[ 0], x[12],  7);  SALSA_STEP_8WAY(x[ 9], x[ 5], x[ 1],  7);
+		SALSA_STEP_8WAY(x[14], x[10], x[ 6],  7);  SALSA_STEP_8WAY(x[ 3], x[15], x[11],  7);
+
+		SALSA_STEP_8WAY(x[ 8], x[ 4], x[ 0],  9);  SALSA_STEP_8WAY(x[13], x[ 9], x[ 5],  9);
+		SALSA_STEP_8WAY(x[ 2], x[14], x[10],  9);  SALSA_STEP_8WAY(x[ 7], x[ 3], x[15],  9);
+
+		SALSA_STEP_8WAY(x[12], x[ 8], x[ 4], 13);  SALSA_STEP_8WAY(x[ 1], x[13], x[ 9], 13);
+		SALSA_STEP_8WAY(x[ 6], x[ 2], x[14], 13);  SALSA_STEP_8WAY(x[11], x[ 7], x[ 3], 13);
+
+		SALSA_STEP_8WAY(x[ 0], x[12], x[ 8], 18);  SALSA_STEP_8WAY(x[ 5], x[ 1], x[13], 18);
+		SALSA_STEP_8WAY(x[10], x[ 6], x[ 2], 18);  SALSA_STEP_8WAY(x[15], x[11], x[ 7], 18);
+
+		/* Operate on rows. */
+		SALSA_STEP_8WAY(x[ 1], x[ 0], x[ 3],  7);  SALSA_STEP_8WAY(x[ 6], x[ 5], x[ 4],  7);
+		SALSA_STEP_8WAY(x[11], x[10], x[ 9],  7);  SALSA_STEP_8WAY(x[12], x[15], x[14],  7);
+
+		SALSA_STEP_8WAY(x[ 2], x[ 1], x[ 0],  9);  SALSA_STEP_8WAY(x[ 7], x[ 6], x[ 5],  9);
+		SALSA_STEP_8WAY(x[ 8], x[11], x[10],  9);  SALSA_STEP_8WAY(x[13], x[12], x[15],  9);
+
+		SALSA_STEP_8WAY(x[ 3], x[ 2], x[ 1], 13);  SALSA_STEP_8WAY(x[ 4], x[ 7], x[ 6], 13);
+		SALSA_STEP_8WAY(x[ 9], x[ 8], x[11], 13);  SALSA_STEP_8WAY(x[14], x[13], x[12], 13);
+
+		SALSA_STEP_8WAY(x[ 0], x[ 3], x[ 2], 18);  SALSA_STEP_8WAY(x[ 5], x[ 4], x[ 7], 18);
+		SALSA_STEP_8WAY(x[10], x[ 9], x[ 8], 18);  SALSA_STEP_8WAY(x[15], x[14], x[13], 18);
+	}
+
+	for (i = 0; i < 16; i++)
+		B[i] = _mm256_add_epi32(B[i], x[i]);
+}
+
+__attribute__((target("avx2")))
+void scrypt_1024_1_1_256_sp_avx2_8way(const char *input, char *output, char *scratchpad)
+{
+	uint8_t B[8][128];
+	union {
+		__m256i i256[32];
+		uint32_t u32[32][8];
+	} X;
+	__m256i *V;
+	uint32_t i, k, l;
+
+	V = (__m256i *)(((uintptr_t)(scratchpad) + 63) & ~ (uintptr_t)(63));
+
+	for (l = 0; l < 8; l++) {
+		PBKDF2_SHA256((const uint8_t *)input + l * 80, 80, (const uint8_t *)input + l * 80, 80, 1, B[l], 128);
+		for (k = 0; k < 32; k++)
+			X.u32[k][l] = le32dec(&B[l][4 * k]);
+	}
+
+	for (i = 0; i < 1024; i++) {
+		for (k = 0; k < 32; k++)
+			V[i * 32 + k] = X.i256[k];
+		xor_salsa8_8way(&X.i256[0], &X.i256[16]);
+		xor_salsa8_8way(&X.i256[16], &X.i256[0]);
+	}
+	for (i = 0; i < 1024; i++) {
+		/* Gather lane l of V[j_l * 32 + k] for every lane at once. */
+		const __m256i lane = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+		__m256i idx = _mm256_and_si256(X.i256[16], _mm256_set1_epi32(1023));
+		idx = _mm256_add_epi32(_mm256_slli_epi32(idx, 8), lane);
+		for (k = 0; k < 32; k++) {
+			X.i256[k] = _mm256_xor_si256(X.i256[k], _mm256_i32gather_epi32((const int *)V, idx, 4));
+			idx = _mm256_add_epi32(idx, _mm256_set1_epi32(8));
+		}
+		xor_salsa8_8way(&X.i256[0], &X.i256[16]);
+		xor_salsa8_8way(&X.i256[16], &X.i256[0]);
+	}
+
+	for (l = 0; l < 8; l++) {
+		for (k = 0; k < 32; k++)
+			le32enc(&B[l][4 * k], X.u32[k][l]);
+		PBKDF2_SHA256((const uint8_t *)input + l * 80, 80, B[l], 128, 1, (uint8_t *)output + l * 32, 32);
+	}
+}
+#endif // USE_SCRYPT_AVX2
+
 #endif // USE_SSE2
@@ -290,10 +290,18 @@ void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scrat
 #if defined(USE_SSE2)
 // By default, set to generic scrypt function. This will prevent crash in case when scrypt_detect_sse2() wasn't called
 void (*scrypt_1024_1_1_256_sp_detected)(const char *input, char *output, char *scratchpad) = &scrypt_1024_1_1_256_sp_generic;
+#if defined(USE_SCRYPT_AVX2)
+// Likewise, only use the 8-way AVX2 kernel once scrypt_detect_sse2() has seen CPU support for it
+bool scrypt_avx2_detected = false;
+#endif
 
 std::string scrypt_detect_sse2()
 {
     std::string ret;
+#if defined(USE_SCRYPT_AVX2)
+    __builtin_cpu_init();
+    scrypt_avx2_detected = __builtin_cpu_supports("avx2");
+#endif
 #if defined(USE_SSE2_ALWAYS)
     ret = "scrypt: using scrypt-sse2 as built.";
 #else // USE_SSE2_ALWAYS
@@ -321,6 +329,10 @@ std::string scrypt_detect_sse2()
         ret = "scrypt: using scrypt-generic, SSE2 unavailable";
     }
 #endif // USE_SSE2_ALWAYS
+#if defined(USE_SCRYPT_AVX2)
+    if (scrypt_avx2_detected)
+        ret += " (8-way avx2 available)";
+#endif
     return ret;
 }
 #endif
@@ -330,3 +342,33 @@ void scrypt_1024_1_1_256(const char *input, char *output)
 	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
     scrypt_1024_1_1_256_sp(input, output, scratchpad);
 }
+
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t count)
+{
+	char *scratchpad = (char *)malloc(SCRYPT_MULTI_SCRATCHPAD_SIZE);
+	scrypt_1024_1_1_256_multi_sp(input, output, count, scratchpad);
+	free(scratchpad);
+}
+
+void scrypt_1024_1_1_256_multi_sp(const char *input, char *output, size_t count, char *scratchpad)
+{
+	size_t i = 0;
+
+#if defined(USE_SSE2)
+#if defined(USE_SCRYPT_AVX2)
+	if (scrypt_avx2_detected) {
+		for (; i + 8 <= count; i += 8)
+			scrypt_1024_1_1_256_sp_avx2_8way(input + i * 80, output + i * 32, scratchpad);
+	}
+#endif
+#if !defined(USE_SSE2_ALWAYS)
+	if (scrypt_1024_1_1_256_sp_detected == &scrypt_1024_1_1_256_sp_sse2)
+#endif
+	{
+		for (; i + 4 <= count; i += 4)
+			scrypt_1024_1_1_256_sp_sse2_4way(input + i * 80, output + i * 32, scratchpad);
+	}
+#endif
+	for (; i < count; i++)
+		scrypt_1024_1_1_256_sp(input + i * 80, output + i * 32, scratchpad);
+}
@@ -4,10 +4,21 @@
 #include <stdint.h>
 
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
+/* Large enough for the widest (8-way) multi-buffer kernel. */
+static const int SCRYPT_MULTI_SCRATCHPAD_SIZE = 8 * 131072 + 63;
 
 void scrypt_1024_1_1_256(const char *input, char *output);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+/**
+ * Hash count consecutive 80-byte inputs into count consecutive 32-byte
+ * outputs. Uses the 4-way SSE2 and 8-way AVX2 multi-buffer kernels when
+ * they are available, falling back to one hash at a time otherwise.
+ */
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t count);
+/* Same as above with a caller-owned scratchpad of SCRYPT_MULTI_SCRATCHPAD_SIZE bytes. */
+void scrypt_1024_1_1_256_multi_sp(const char *input, char *output, size_t count, char *scratchpad);
+
 #if defined(USE_SSE2)
 #include <string>
 #if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
@@ -17,9 +28,20 @@ void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scrat
 #define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_detected((input), (output), (scratchpad))
 #endif
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+#define USE_SCRYPT_AVX2 1
+#endif
+
 std::string scrypt_detect_sse2();
 void scrypt_1024_1_1_256_sp_sse2(const char *input, char *output, char *scratchpad);
 extern void (*scrypt_1024_1_1_256_sp_detected)(const char *input, char *output, char *scratchpad);
+
+/* Multi-buffer kernels: 4 (resp. 8) inputs, outputs and scratchpads back to back. */
+void scrypt_1024_1_1_256_sp_sse2_4way(const char *input, char *output, char *scratchpad);
+#if defined(USE_SCRYPT_AVX2)
+void scrypt_1024_1_1_256_sp_avx2_8way(const char *input, char *output, char *scratchpad);
+extern bool scrypt_avx2_detected;
+#endif
 #else
 #define scrypt_1024_1_1_256_sp(input, output, scratchpad) scrypt_1024_1_1_256_sp_generic((input), (output), (scratchpad))
 #endif
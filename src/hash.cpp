@@ -245,3 +245,63 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+#define USE_SIPHASH_AVX2 1
+#include <immintrin.h>
+
+#define ROTL_4WAY(x, b) _mm256_or_si256(_mm256_slli_epi64((x), (b)), _mm256_srli_epi64((x), 64 - (b)))
+/* Rotating by 32 swaps the halves of each lane */
+#define ROTL32_4WAY(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+#define SIPROUND_4WAY do { \
+    v0 = _mm256_add_epi64(v0, v1); v1 = ROTL_4WAY(v1, 13); v1 = _mm256_xor_si256(v1, v0); \
+    v0 = ROTL32_4WAY(v0); \
+    v2 = _mm256_add_epi64(v2, v3); v3 = ROTL_4WAY(v3, 16); v3 = _mm256_xor_si256(v3, v2); \
+    v0 = _mm256_add_epi64(v0, v3); v3 = ROTL_4WAY(v3, 21); v3 = _mm256_xor_si256(v3, v0); \
+    v2 = _mm256_add_epi64(v2, v1); v1 = ROTL_4WAY(v1, 17); v1 = _mm256_xor_si256(v1, v2); \
+    v2 = ROTL32_4WAY(v2); \
+} while (0)
+
+__attribute__((target("avx2")))
+static void SipHashUint256_4way(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out)
+{
+    __m256i v0 = _mm256_set1_epi64x(0x736f6d6570736575ULL ^ k0);
+    __m256i v1 = _mm256_set1_epi64x(0x646f72616e646f6dULL ^ k1);
+    __m256i v2 = _mm256_set1_epi64x(0x6c7967656e657261ULL ^ k0);
+    __m256i v3 = _mm256_set1_epi64x(0x7465646279746573ULL ^ k1);
+
+    for (int i = 0; i < 4; i++) {
+        __m256i d = _mm256_set_epi64x(vals[3]->GetUint64(i), vals[2]->GetUint64(i), vals[1]->GetUint64(i), vals[0]->GetUint64(i));
+        v3 = _mm256_xor_si256(v3, d);
+        SIPROUND_4WAY;
+        SIPROUND_4WAY;
+        v0 = _mm256_xor_si256(v0, d);
+    }
+    const __m256i t = _mm256_set1_epi64x(((uint64_t)4) << 59);
+    v3 = _mm256_xor_si256(v3, t);
+    SIPROUND_4WAY;
+    SIPROUND_4WAY;
+    v0 = _mm256_xor_si256(v0, t);
+    v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xFF));
+    SIPROUND_4WAY;
+    SIPROUND_4WAY;
+    SIPROUND_4WAY;
+    SIPROUND_4WAY;
+    _mm256_storeu_si256((__m256i*)out, _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3)));
+}
+#endif
+
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256* const* vals, size_t count, uint64_t* out)
+{
+    size_t i = 0;
+#if defined(USE_SIPHASH_AVX2)
+    static const bool fAVX2 = __builtin_cpu_supports("avx2");
+    if (fAVX2) {
+        for (; i + 4 <= count; i += 4)
+            SipHashUint256_4way(k0, k1, vals + i, out + i);
+    }
+#endif
+    for (; i < count; i++)
+        out[i] = SipHashUint256(k0, k1, *vals[i]);
+}
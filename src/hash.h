@@ -229,4 +229,11 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** SipHashUint256 of count values, where vals[i] points at the i-th value.
+ *
+ *  Where the CPU supports AVX2, four values are hashed at a time, one in
+ *  each 64-bit lane of the state registers.
+ */
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256* const* vals, size_t count, uint64_t* out);
+
 #endif // BITCOIN_HASH_H
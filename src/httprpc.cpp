@@ -7,6 +7,7 @@
 #include <base58.h>
 #include <chainparams.h>
 #include <httpserver.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -144,6 +145,45 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Results holding at least this many JSON values are streamed back to the client */
+static const size_t RPC_STREAM_MIN_VALUES = 4096;
+
+/** Count the values in a JSON document, giving up once nLimit is reached */
+static size_t CountJSONValues(const UniValue& value, size_t nLimit)
+{
+    size_t nCount = 1;
+    if (value.isArray() || value.isObject()) {
+        for (const UniValue& child : value.getValues()) {
+            if (nCount >= nLimit)
+                break;
+            nCount += CountJSONValues(child, nLimit - nCount);
+        }
+    }
+    return nCount;
+}
+
+/**
+ * Send a reply with the same content as JSONRPCReply(result, NullUniValue, id),
+ * serializing the result piece by piece instead of into one string.
+ */
+static void JSONRPCStreamReply(HTTPRequest* req, const UniValue& result, const UniValue& id)
+{
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReplyStart(HTTP_OK);
+    JSONStreamWriter writer([req](const std::string& chunk) { req->WriteReplyChunk(chunk); });
+    writer.BeginObject();
+    writer.Key("result");
+    writer.Value(result);
+    writer.Key("error");
+    writer.Value(NullUniValue);
+    writer.Key("id");
+    writer.Value(id);
+    writer.EndObject();
+    writer.Raw("\n");
+    writer.Flush();
+    req->WriteReplyEnd();
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -189,6 +229,13 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
             UniValue result = tableRPC.execute(jreq);
 
+            // Large results, such as verbose blocks or mempools, are streamed
+            // instead of being copied into a reply string first
+            if (CountJSONValues(result, RPC_STREAM_MIN_VALUES) >= RPC_STREAM_MIN_VALUES) {
+                JSONRPCStreamReply(req, result, jreq.id);
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
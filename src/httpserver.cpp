@@ -40,6 +40,8 @@
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
+/** Bytes of a streamed reply that may wait to be sent before WriteReplyChunk blocks */
+static const size_t MAX_STREAM_BUFFERED = 1024 * 1024;
 
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
@@ -524,12 +526,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyStarted && !replySent) {
+        // A streamed reply can't turn into an error any more; just end it
+        LogPrintf("%s: Unfinished streamed reply\n", __func__);
+        WriteReplyEnd();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -580,9 +587,24 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  * Replies must be sent in the main loop in the main http thread,
  * this cannot be done from worker threads.
  */
+/** Re-enable reading from the socket. This is the second part of the libevent
+ * workaround in http_request_cb. */
+static void http_reenable_read(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && !replyStarted && req);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -590,21 +612,151 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
+        http_reenable_read(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+/**
+ * A streamed reply is written by a worker thread and sent by the http
+ * thread. This tracks how much of it is still waiting to be sent, and
+ * whether the connection is gone, in which case libevent may have freed
+ * the request.
+ */
+struct HTTPReplyStream
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Bytes in chunk events that have not been handed to libevent yet
+    size_t nQueued;
+    //! Bytes in the output buffer of the connection when it was last looked at
+    size_t nOutput;
+    //! Set by libevent when the connection is closed
+    bool fClosed;
+    //! Set by the worker when the client stopped reading
+    bool fStalled;
+
+    HTTPReplyStream() : nQueued(0), nOutput(0), fClosed(false), fStalled(false) {}
+};
+
+/** Called by libevent once the output buffer of a streamed reply has drained */
+static void http_stream_drained_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyStream* stream = static_cast<HTTPReplyStream*>(arg);
+    {
+        std::lock_guard<std::mutex> lock(stream->cs);
+        stream->nOutput = 0;
+    }
+    stream->cond.notify_all();
+}
+
+/** Called by libevent when the connection of a streamed reply is closed */
+static void http_stream_closed_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyStream* stream = static_cast<HTTPReplyStream*>(arg);
+    {
+        std::lock_guard<std::mutex> lock(stream->cs);
+        stream->fClosed = true;
+    }
+    stream->cond.notify_all();
+}
+
+void HTTPRequest::WriteReplyStart(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    stream = std::make_shared<HTTPReplyStream>();
+    auto req_copy = req;
+    auto stream_copy = stream;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, stream_copy, nStatus]{
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (!conn) {
+            http_stream_closed_cb(nullptr, stream_copy.get());
+            return;
+        }
+        // Cleared by WriteReplyEnd, which keeps the stream state alive until then
+        evhttp_connection_set_closecb(conn, http_stream_closed_cb, stream_copy.get());
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& chunk)
+{
+    assert(replyStarted && !replySent && req);
+    if (chunk.empty())
+        return;
+    {
+        // Wait for the client to catch up, so that the reply doesn't pile up
+        // in memory. libevent closes connections that stall for longer than
+        // -rpcservertimeout; waiting that long here as well makes sure the
+        // worker is never stuck.
+        const int64_t nTimeout = gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT);
+        std::unique_lock<std::mutex> lock(stream->cs);
+        if (!stream->cond.wait_for(lock, std::chrono::seconds(nTimeout), [this]{ return stream->fClosed || stream->fStalled || stream->nQueued + stream->nOutput < MAX_STREAM_BUFFERED; })) {
+            LogPrint(BCLog::HTTP, "Streamed reply stalled, dropping the rest\n");
+            stream->fStalled = true;
+        }
+        if (stream->fClosed || stream->fStalled)
+            return;
+        stream->nQueued += chunk.size();
+    }
+    // Events are handled in the order they were triggered, so the chunks
+    // arrive in order after the reply start.
+    auto req_copy = req;
+    auto stream_copy = stream;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, stream_copy, chunk]{
+        bool fClosed;
+        {
+            std::lock_guard<std::mutex> lock(stream_copy->cs);
+            stream_copy->nQueued -= chunk.size();
+            fClosed = stream_copy->fClosed;
+        }
+        size_t nOutput = 0;
+        if (!fClosed) {
+            struct evbuffer* evb = evbuffer_new();
+            if (evb) {
+                evbuffer_add(evb, chunk.data(), chunk.size());
+                evhttp_send_reply_chunk_with_cb(req_copy, evb, http_stream_drained_cb, stream_copy.get());
+                evbuffer_free(evb);
             }
+            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+            bufferevent* bev = conn ? evhttp_connection_get_bufferevent(conn) : nullptr;
+            if (bev)
+                nOutput = evbuffer_get_length(bufferevent_get_output(bev));
+        }
+        {
+            std::lock_guard<std::mutex> lock(stream_copy->cs);
+            stream_copy->nOutput = nOutput;
+        }
+        stream_copy->cond.notify_all();
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::WriteReplyEnd()
+{
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    auto stream_copy = stream;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, stream_copy]{
+        {
+            std::lock_guard<std::mutex> lock(stream_copy->cs);
+            if (stream_copy->fClosed)
+                return;
         }
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn)
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        evhttp_send_reply_end(req_copy);
+        http_reenable_read(req_copy);
     });
     ev->trigger(nullptr);
     replySent = true;
     req = nullptr; // transferred back to main thread
+    stream.reset();
 }
 
 CService HTTPRequest::GetPeer()
@@ -8,6 +8,7 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -17,6 +18,7 @@ struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+struct HTTPReplyStream;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -59,6 +61,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
+    //! Flow control state of a streamed reply, shared with the http thread
+    std::shared_ptr<HTTPReplyStream> stream;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -114,6 +119,32 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a streamed HTTP reply, sent with chunked transfer encoding.
+     * nStatus is the HTTP status code to send. The body follows in calls to
+     * WriteReplyChunk, and WriteReplyEnd finishes the reply.
+     *
+     * @note Use this instead of WriteReply. Headers must be written before
+     * calling this, and the status can't be changed afterwards.
+     */
+    void WriteReplyStart(int nStatus);
+
+    /**
+     * Send the next piece of a streamed reply.
+     *
+     * @note Blocks while too much of the reply is waiting to be sent to the
+     * client. Once the client has disconnected, chunks are dropped.
+     */
+    void WriteReplyChunk(const std::string& chunk);
+
+    /**
+     * Finish a streamed reply.
+     *
+     * @note As this will give the request back to the main thread, do not
+     * call any other HTTPRequest methods after calling this.
+     */
+    void WriteReplyEnd();
 };
 
 /** Event handler closure.
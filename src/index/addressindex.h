@@ -53,6 +53,10 @@ struct CAddressUnspentKey {
         txhash.SetNull();
         index = 0;
     }
+
+    friend bool operator==(const CAddressUnspentKey& a, const CAddressUnspentKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.txhash == b.txhash && a.index == b.index;
+    }
 };
 
 struct CAddressUnspentValue {
@@ -151,6 +155,10 @@ struct CAddressIndexKey {
         spending = false;
     }
 
+    friend bool operator==(const CAddressIndexKey& a, const CAddressIndexKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.blockHeight == b.blockHeight &&
+               a.txindex == b.txindex && a.txhash == b.txhash && a.index == b.index && a.spending == b.spending;
+    }
 };
 
 struct CAddressIndexIteratorKey {
@@ -224,6 +232,48 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/**
+ * Running totals for one address, kept next to its deltas so that balance
+ * queries don't have to walk the address's whole history.
+ */
+struct CAddressSummaryValue {
+    CAmount balance;
+    CAmount received;
+    CAmount sent;
+    uint32_t txCount;
+    int firstHeight;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(sent);
+        READWRITE(txCount);
+        READWRITE(firstHeight);
+        READWRITE(lastHeight);
+    }
+
+    CAddressSummaryValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        sent = 0;
+        txCount = 0;
+        firstHeight = -1;
+        lastHeight = -1;
+    }
+
+    bool IsNull() const {
+        return (txCount == 0);
+    }
+};
+
 struct CMempoolAddressDelta
 {
     int64_t time;
@@ -294,4 +344,45 @@ struct CMempoolAddressDeltaKeyCompare
     }
 };
 
+/** Address part of a CMempoolAddressDeltaKey, used to look up all mempool deltas of one address */
+struct CMempoolAddressKey
+{
+    int type;
+    uint160 addressBytes;
+
+    CMempoolAddressKey(int addressType, uint160 addressHash) {
+        type = addressType;
+        addressBytes = addressHash;
+    }
+
+    friend bool operator==(const CMempoolAddressKey& a, const CMempoolAddressKey& b) {
+        return a.type == b.type && a.addressBytes == b.addressBytes;
+    }
+
+    friend bool operator<(const CMempoolAddressKey& a, const CMempoolAddressKey& b) {
+        return a.type < b.type || (a.type == b.type && a.addressBytes < b.addressBytes);
+    }
+};
+
+/** One mempool delta in the per-address list of the mempool address index */
+struct CMempoolAddressDeltaEntry
+{
+    uint256 txhash;
+    unsigned int index;
+    int spending;
+    CMempoolAddressDelta delta;
+
+    CMempoolAddressDeltaEntry(uint256 hash, unsigned int i, int s, const CMempoolAddressDelta& d) : delta(d) {
+        txhash = hash;
+        index = i;
+        spending = s;
+    }
+
+    CMempoolAddressDeltaEntry() : delta(0, 0) {
+        txhash.SetNull();
+        index = 0;
+        spending = 0;
+    }
+};
+
 #endif // BITCOIN_ADDRESSINDEX_H
@@ -11,6 +11,8 @@
 
 #include <addrman.h>
 #include <amount.h>
+#include <blockfilereader.h>
+#include <blockprefetcher.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -21,6 +23,7 @@
 #include <httprpc.h>
 #include <key.h>
 #include <validation.h>
+#include <mempooljournal.h>
 #include <miner.h>
 #include <netbase.h>
 #include <net.h>
@@ -35,6 +38,7 @@
 #include <script/standard.h>
 #include <script/sigcache.h>
 #include <scheduler.h>
+#include <stats/stats.h>
 #include <timedata.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -192,6 +196,10 @@ void Shutdown()
     StopREST();
     StopRPC();
     StopHTTPServer();
+    if (g_block_template_cache) {
+        UnregisterValidationInterface(g_block_template_cache.get());
+        g_block_template_cache->Stop();
+    }
 #ifdef ENABLE_WALLET
     FlushWallets();
 #endif
@@ -210,8 +218,27 @@ void Shutdown()
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
-
-    if (fDumpMempoolLater && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+    g_block_template_cache.reset();
+    g_block_prefetcher.reset();
+
+    if (g_mempool_journal) {
+        // Only the records still queued for the journal are left to write
+        GetMainSignals().FlushBackgroundCallbacks();
+        UnregisterValidationInterface(g_mempool_journal.get());
+        g_mempool_journal->Stop();
+        if (g_mempool_journal->IsFailed()) {
+            // The journal misses everything since its write error. mempool.dat
+            // is only read once the journal is gone.
+            if (DumpMempool()) {
+                try {
+                    fs::remove(GetDataDir() / MEMPOOL_JOURNAL_FILENAME);
+                } catch (const fs::filesystem_error& e) {
+                    LogPrintf("%s: Unable to remove mempool journal: %s\n", __func__, e.what());
+                }
+            }
+        }
+        g_mempool_journal.reset();
+    } else if (fDumpMempoolLater && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
     }
 
@@ -229,6 +256,11 @@ void Shutdown()
 
     // FlushStateToDisk generates a SetBestChain callback, which we should avoid missing
     if (pcoinsTip != nullptr) {
+        // Taken before the flush below empties the cache. It is tagged with the
+        // cache's best block, which the flush makes the coins database's too.
+        if (gArgs.GetBoolArg("-dbcachesnapshot", DEFAULT_DBCACHE_SNAPSHOT)) {
+            DumpCoinsCacheSnapshot();
+        }
         FlushStateToDisk();
     }
 
@@ -344,7 +376,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("Print this help message and exit"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockmmap", strprintf(_("Read blocks through memory maps of the block files instead of copying them. An I/O error or a truncated block file then terminates the process (default: %u)"), DEFAULT_BLOCK_MMAP));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
+    strUsage += HelpMessageOpt("-blockprefetch=<n>", strprintf(_("Read up to <n> blocks ahead of the one being connected during initial block download, along with the coins they spend (0 to %d, default: %d)"), MAX_BLOCK_PREFETCH, DEFAULT_BLOCK_PREFETCH));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
     strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()));
@@ -360,13 +394,18 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
     }
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbcachesnapshot", strprintf(_("Save the in-memory UTXO cache on shutdown and load it back on restart (default: %u)"), DEFAULT_DBCACHE_SNAPSHOT));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-importthreads=<n>", strprintf(_("Set the number of threads deserializing and checking blocks during -reindex and -loadblock (0 to %d, 0 = one per core, default: %d)"), MAX_IMPORT_THREADS, DEFAULT_IMPORT_THREADS));
     strUsage += HelpMessageOpt("-debuglogfile=<file>", strprintf(_("Specify location of debug log file: this can be an absolute path or a path relative to the data directory (default: %s)"), DEFAULT_DEBUGLOGFILE));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
+    strUsage += HelpMessageOpt("-mempooljournal", strprintf(_("Keep the saved mempool up to date in a journal while running, instead of writing it out at shutdown (default: %u)"), DEFAULT_MEMPOOL_JOURNAL));
+    strUsage += HelpMessageOpt("-mempoolstats", strprintf(_("Collect a history of mempool, orphan pool and network statistics for getmempoolstats (default: %u)"), DEFAULT_MEMPOOL_STATS));
+    strUsage += HelpMessageOpt("-mempoolparallelinputs=<n>", strprintf(_("Verify the scripts of transactions with at least <n> inputs on the script verification threads when accepting them to the mempool (0 = never, default: %u)"), DEFAULT_MEMPOOL_PARALLEL_INPUTS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()));
     }
@@ -407,6 +446,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msgthreads=<n>", strprintf(_("Number of threads decoding and checking received blocks and transactions ahead of processing (0 to %d, default: %d)"), MAX_MESSAGE_PREPARE_THREADS, DEFAULT_MESSAGE_PREPARE_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -449,6 +489,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockindexpow", strprintf("Recompute and check the proof of work of every block header in the block index at startup, spread over the -par threads (default: %u)", DEFAULT_CHECKBLOCKINDEXPOW));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
@@ -506,6 +547,8 @@ std::string HelpMessage(HelpMessageMode mode)
 
     strUsage += HelpMessageGroup(_("Block creation options:"));
     strUsage += HelpMessageOpt("-blockmaxweight=<n>", strprintf(_("Set maximum BIP141 block weight (default: %d)"), DEFAULT_BLOCK_MAX_WEIGHT));
+    strUsage += HelpMessageOpt("-genthreads=<n>", strprintf(_("Set the number of threads generate and generatetoaddress mine on (0 to %d, 0 = one per core, default: %d)"), MAX_GENERATE_THREADS, DEFAULT_GENERATE_THREADS));
+    strUsage += HelpMessageOpt("-blocktemplatecache", strprintf(_("Keep a block template up to date in the background for getblocktemplate (default: %u)"), DEFAULT_BLOCK_TEMPLATE_CACHE));
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
@@ -705,6 +748,16 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
     if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         LoadMempool();
         fDumpMempoolLater = !fRequestShutdown;
+        if (fDumpMempoolLater && gArgs.GetBoolArg("-mempooljournal", DEFAULT_MEMPOOL_JOURNAL)) {
+            g_mempool_journal.reset(new CMempoolJournal(GetDataDir() / MEMPOOL_JOURNAL_FILENAME));
+            // Registered first, so no change is missed between the snapshot
+            // Start() writes and the records appended after it
+            RegisterValidationInterface(g_mempool_journal.get());
+            if (!g_mempool_journal->Start()) {
+                UnregisterValidationInterface(g_mempool_journal.get());
+                g_mempool_journal.reset();
+            }
+        }
     }
 }
 
@@ -930,8 +983,13 @@ bool AppInitParameterInteraction()
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
+#ifdef USE_EPOLL
+    int fd_max = nFD;
+#else
+    int fd_max = FD_SETSIZE;
+#endif
+    nMaxConnections = std::max(std::min(nMaxConnections, fd_max - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS), 0);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
     nMaxConnections = std::min(nFD - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS, nMaxConnections);
@@ -992,6 +1050,7 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    fCheckBlockIndexPoW = gArgs.GetBoolArg("-checkblockindexpow", DEFAULT_CHECKBLOCKINDEXPOW);
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
@@ -1038,6 +1097,13 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    int64_t nParallelInputs = gArgs.GetArg("-mempoolparallelinputs", DEFAULT_MEMPOOL_PARALLEL_INPUTS);
+    if (nParallelInputs < 0)
+        return InitError(_("-mempoolparallelinputs cannot be negative."));
+    nMempoolParallelInputs = (unsigned int)std::min<int64_t>(nParallelInputs, std::numeric_limits<unsigned int>::max());
+
+    g_block_file_reader.SetMapFiles(gArgs.GetBoolArg("-blockmmap", DEFAULT_BLOCK_MMAP));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1250,6 +1316,9 @@ bool AppInitMain()
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // Header PoW checks use a pool of the same size, they are idle outside of header sync
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHeaderPoWCheck);
     }
 
     // Start the lightweight task scheduler thread
@@ -1576,6 +1645,11 @@ bool AppInitMain()
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
+
+                    if (gArgs.GetBoolArg("-dbcachesnapshot", DEFAULT_DBCACHE_SNAPSHOT)) {
+                        uiInterface.InitMessage(_("Loading UTXO cache..."));
+                        LoadCoinsCacheSnapshot();
+                    }
                 }
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
@@ -1676,6 +1750,11 @@ bool AppInitMain()
         vImportFiles.push_back(strFile);
     }
 
+    int nBlockPrefetch = std::min<int>(gArgs.GetArg("-blockprefetch", DEFAULT_BLOCK_PREFETCH), MAX_BLOCK_PREFETCH);
+    if (nBlockPrefetch > 0) {
+        g_block_prefetcher.reset(new CBlockPrefetcher(pcoinsdbview.get(), chainparams.GetConsensus(), nBlockPrefetch, BLOCK_PREFETCH_THREADS));
+    }
+
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
     // Wait for genesis block to be processed
@@ -1725,6 +1804,7 @@ bool AppInitMain()
     connOptions.m_msgproc = peerLogic.get();
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMessagePrepareThreads = std::max(0, std::min<int>(MAX_MESSAGE_PREPARE_THREADS, gArgs.GetArg("-msgthreads", DEFAULT_MESSAGE_PREPARE_THREADS)));
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
@@ -1770,6 +1850,19 @@ bool AppInitMain()
         return false;
     }
 
+    if (gArgs.GetBoolArg("-blocktemplatecache", DEFAULT_BLOCK_TEMPLATE_CACHE)) {
+        g_block_template_cache.reset(new BlockTemplateCache(chainparams));
+        RegisterValidationInterface(g_block_template_cache.get());
+        g_block_template_cache->Start();
+    }
+
+    if (gArgs.GetBoolArg("-mempoolstats", DEFAULT_MEMPOOL_STATS))
+        CStats::m_stats_enabled = true;
+    if (CStats::m_stats_enabled) {
+        RegisterValidationInterface(CStats::DefaultStats());
+        scheduler.scheduleEvery(std::bind(&CStats::CollectSample, CStats::DefaultStats()), STATS_SAMPLE_INTERVAL * 1000);
+    }
+
     // ********************************************************* Step 12: finished
 
     SetRPCWarmupFinished();
@@ -0,0 +1,323 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooljournal.h>
+
+#include <clientversion.h>
+#include <crypto/common.h>
+#include <hash.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <string.h>
+
+std::unique_ptr<CMempoolJournal> g_mempool_journal;
+
+static const uint64_t MEMPOOL_JOURNAL_VERSION = 1;
+
+/** Seconds between checks whether the journal has grown enough to be compacted */
+static const int MEMPOOL_JOURNAL_CHECK_INTERVAL = 10;
+
+/**
+ * Each record is a type byte, the payload size and the first four bytes of
+ * the payload's double-SHA256, followed by the payload itself.
+ */
+enum MempoolJournalRecord : unsigned char {
+    //! A transaction with its acceptance time and fee delta
+    RECORD_ADD = 'a',
+    //! The txid of a transaction that left the mempool
+    RECORD_REMOVE = 'r',
+    //! Fee deltas of transactions that are not in the mempool, replacing earlier ones
+    RECORD_DELTAS = 'd',
+};
+static const size_t RECORD_HEADER_SIZE = 9;
+
+template <typename T>
+static void AppendRecord(std::vector<unsigned char>& out, MempoolJournalRecord type, const T& payload)
+{
+    CDataStream ssPayload(SER_DISK, CLIENT_VERSION);
+    ssPayload << payload;
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+
+    unsigned char header[RECORD_HEADER_SIZE];
+    header[0] = type;
+    WriteLE32(header + 1, ssPayload.size());
+    memcpy(header + 5, hash.begin(), 4);
+    out.insert(out.end(), header, header + RECORD_HEADER_SIZE);
+    out.insert(out.end(), (const unsigned char*)ssPayload.data(), (const unsigned char*)ssPayload.data() + ssPayload.size());
+}
+
+CMempoolJournal::CMempoolJournal(const fs::path& pathIn) :
+    path(pathIn), file(nullptr), nFileSize(0), fCompacting(false), fStop(false), fFailed(false)
+{
+}
+
+CMempoolJournal::~CMempoolJournal()
+{
+    Stop();
+}
+
+bool CMempoolJournal::Start()
+{
+    if (!Compact())
+        return false;
+    thread = std::thread(&TraceThread<std::function<void()> >, "mempooljrnl", std::function<void()>(std::bind(&CMempoolJournal::ThreadCompact, this)));
+    return true;
+}
+
+void CMempoolJournal::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (thread.joinable())
+        thread.join();
+
+    std::lock_guard<std::mutex> lock(cs);
+    if (file) {
+        FileCommit(file);
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool CMempoolJournal::IsFailed()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return fFailed;
+}
+
+void CMempoolJournal::Append(const std::vector<unsigned char>& record)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (fCompacting)
+        vPending.insert(vPending.end(), record.begin(), record.end());
+    if (!file)
+        return;
+    if (fwrite(record.data(), 1, record.size(), file) != record.size() || fflush(file) != 0) {
+        LogPrintf("%s: Failed to write to %s, no longer journaling the mempool\n", __func__, path.string());
+        fclose(file);
+        file = nullptr;
+        fFailed = true;
+        return;
+    }
+    nFileSize += record.size();
+}
+
+void CMempoolJournal::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    // Fee deltas set with prioritisetransaction before the transaction
+    // arrived are known by now; later ones are picked up by the next compaction.
+    CAmount nFeeDelta = 0;
+    mempool.ApplyDelta(ptx->GetHash(), nFeeDelta);
+
+    std::vector<unsigned char> record;
+    AppendRecord(record, RECORD_ADD, MempoolDiskEntry{ptx, GetTime(), nFeeDelta});
+    Append(record);
+}
+
+void CMempoolJournal::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    std::vector<unsigned char> record;
+    AppendRecord(record, RECORD_REMOVE, ptx->GetHash());
+    Append(record);
+}
+
+void CMempoolJournal::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted)
+{
+    // Transactions leaving the mempool because they were mined or conflict
+    // with the block are not reported through TransactionRemovedFromMempool
+    std::vector<unsigned char> records;
+    for (const CTransactionRef& ptx : pblock->vtx) {
+        if (!ptx->IsCoinBase())
+            AppendRecord(records, RECORD_REMOVE, ptx->GetHash());
+    }
+    for (const CTransactionRef& ptx : vtxConflicted) {
+        AppendRecord(records, RECORD_REMOVE, ptx->GetHash());
+    }
+    if (!records.empty())
+        Append(records);
+}
+
+bool CMempoolJournal::Compact()
+{
+    int64_t nStart = GetTimeMicros();
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fCompacting = true;
+        vPending.clear();
+    }
+
+    std::vector<TxMempoolInfo> vinfo;
+    std::map<uint256, CAmount> mapDeltas;
+    {
+        LOCK(mempool.cs);
+        vinfo = mempool.infoAll();
+        mapDeltas = mempool.mapDeltas;
+    }
+
+    fs::path pathNew = path;
+    pathNew += ".new";
+    FILE* fileNew = fsbridge::fopen(pathNew, "wb");
+    bool fOk = fileNew != nullptr;
+    uint64_t nSize = 0;
+    if (fOk) {
+        std::vector<unsigned char> buf;
+        CVectorWriter(SER_DISK, CLIENT_VERSION, buf, 0) << MEMPOOL_JOURNAL_VERSION;
+        for (const TxMempoolInfo& info : vinfo) {
+            AppendRecord(buf, RECORD_ADD, MempoolDiskEntry{info.tx, info.nTime, info.nFeeDelta});
+            mapDeltas.erase(info.tx->GetHash());
+            if (buf.size() >= (1 << 20)) {
+                fOk = fOk && fwrite(buf.data(), 1, buf.size(), fileNew) == buf.size();
+                nSize += buf.size();
+                buf.clear();
+            }
+        }
+        AppendRecord(buf, RECORD_DELTAS, mapDeltas);
+        fOk = fOk && fwrite(buf.data(), 1, buf.size(), fileNew) == buf.size();
+        nSize += buf.size();
+    }
+
+    std::lock_guard<std::mutex> lock(cs);
+    fCompacting = false;
+    if (fOk) {
+        // Whatever was appended to the old journal since the snapshot was taken
+        fOk = vPending.empty() || fwrite(vPending.data(), 1, vPending.size(), fileNew) == vPending.size();
+        nSize += vPending.size();
+    }
+    vPending.clear();
+    vPending.shrink_to_fit();
+    if (fileNew) {
+        if (fOk) FileCommit(fileNew);
+        fOk = fclose(fileNew) == 0 && fOk;
+    }
+    if (!fOk) {
+        LogPrintf("%s: Failed to write %s\n", __func__, pathNew.string());
+        return false;
+    }
+    // Windows cannot rename over a file that is open, so the old journal is
+    // closed first. If the rename fails anyway, appending to it goes on.
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    bool fRenamed = RenameOver(pathNew, path);
+    if (!fRenamed)
+        LogPrintf("%s: Failed to rename %s to %s\n", __func__, pathNew.string(), path.string());
+    file = fsbridge::fopen(path, "ab");
+    if (!file) {
+        LogPrintf("%s: Failed to open %s\n", __func__, path.string());
+        fFailed = true;
+        return false;
+    }
+    if (!fRenamed)
+        return false;
+    nFileSize = nSize;
+    LogPrint(BCLog::MEMPOOL, "Compacted mempool journal to %u transactions, %u bytes in %dms\n", vinfo.size(), nSize, (GetTimeMicros() - nStart) / 1000);
+    return true;
+}
+
+void CMempoolJournal::ThreadCompact()
+{
+    while (true) {
+        uint64_t nSize;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            cond.wait_for(lock, std::chrono::seconds(MEMPOOL_JOURNAL_CHECK_INTERVAL), [this] { return fStop; });
+            if (fStop)
+                return;
+            if (!file)
+                continue;
+            nSize = nFileSize;
+        }
+        if (nSize < MEMPOOL_JOURNAL_COMPACT_MIN_SIZE || nSize < MEMPOOL_JOURNAL_COMPACT_FACTOR * mempool.GetTotalTxSize())
+            continue;
+        Compact();
+    }
+}
+
+bool CMempoolJournal::Read(const fs::path& path, std::vector<MempoolDiskEntry>& entries, std::map<uint256, CAmount>& mapDeltas)
+{
+    std::vector<unsigned char> data;
+    {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull())
+            return false;
+        // Read in one go rather than record by record
+        if (fseek(file.Get(), 0, SEEK_END) != 0)
+            return false;
+        long nSize = ftell(file.Get());
+        if (nSize < 0 || fseek(file.Get(), 0, SEEK_SET) != 0)
+            return false;
+        data.resize(nSize);
+        if (nSize > 0 && fread(data.data(), 1, nSize, file.Get()) != (size_t)nSize)
+            return false;
+    }
+
+    if (data.size() < sizeof(uint64_t) || ReadLE64(data.data()) != MEMPOOL_JOURNAL_VERSION)
+        return false;
+
+    // Position in entries of each transaction that is still in the journal
+    std::map<uint256, size_t> mapIndex;
+    std::vector<bool> vRemoved;
+    size_t nPos = sizeof(uint64_t);
+    try {
+        while (nPos + RECORD_HEADER_SIZE <= data.size()) {
+            const unsigned char* header = data.data() + nPos;
+            uint32_t nPayloadSize = ReadLE32(header + 1);
+            if (data.size() - nPos - RECORD_HEADER_SIZE < nPayloadSize)
+                break;
+            const unsigned char* payload = header + RECORD_HEADER_SIZE;
+            uint256 hash = Hash(payload, payload + nPayloadSize);
+            if (memcmp(hash.begin(), header + 5, 4) != 0)
+                break;
+            nPos += RECORD_HEADER_SIZE + nPayloadSize;
+
+            CDataStream ssPayload((const char*)payload, (const char*)payload + nPayloadSize, SER_DISK, CLIENT_VERSION);
+            if (header[0] == RECORD_ADD) {
+                MempoolDiskEntry entry;
+                ssPayload >> entry;
+                auto it = mapIndex.find(entry.tx->GetHash());
+                if (it != mapIndex.end()) {
+                    entries[it->second] = entry;
+                    vRemoved[it->second] = false;
+                } else {
+                    mapIndex.emplace(entry.tx->GetHash(), entries.size());
+                    entries.push_back(entry);
+                    vRemoved.push_back(false);
+                }
+            } else if (header[0] == RECORD_REMOVE) {
+                uint256 txid;
+                ssPayload >> txid;
+                auto it = mapIndex.find(txid);
+                if (it != mapIndex.end()) {
+                    vRemoved[it->second] = true;
+                    mapIndex.erase(it);
+                }
+            } else if (header[0] == RECORD_DELTAS) {
+                mapDeltas.clear();
+                ssPayload >> mapDeltas;
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: Failed to deserialize a record of %s: %s\n", __func__, path.string(), e.what());
+    }
+    if (nPos != data.size()) {
+        LogPrintf("%s: Ignoring %u bytes of incomplete records at the end of %s\n", __func__, data.size() - nPos, path.string());
+    }
+
+    size_t nKept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!vRemoved[i])
+            entries[nKept++] = std::move(entries[i]);
+    }
+    entries.resize(nKept);
+    return true;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MEMPOOLJOURNAL_H
+#define BITCOIN_MEMPOOLJOURNAL_H
+
+#include <amount.h>
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <validationinterface.h>
+
+#include <stdint.h>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Default for -mempooljournal */
+static const bool DEFAULT_MEMPOOL_JOURNAL = false;
+/** File name of the mempool journal in the data directory */
+static const char* const MEMPOOL_JOURNAL_FILENAME = "mempool.journal";
+/** The journal is compacted once it is this many times the size of the transactions it describes */
+static const int MEMPOOL_JOURNAL_COMPACT_FACTOR = 3;
+/** Journals smaller than this are never compacted */
+static const uint64_t MEMPOOL_JOURNAL_COMPACT_MIN_SIZE = 16 * 1024 * 1024;
+
+/** A mempool transaction as persisted on disk, by mempool.dat or the journal */
+struct MempoolDiskEntry
+{
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFeeDelta);
+    }
+};
+
+/**
+ * Append-only log of mempool changes, kept up to date from validation
+ * interface callbacks so that the mempool never has to be written out in
+ * full at shutdown. Replaying the records in order gives the mempool as of
+ * the last record written; a record torn by a crash ends the replay.
+ *
+ * Once most of the journal describes transactions that are gone, it is
+ * rewritten from a snapshot of the mempool on its own thread. Records that
+ * arrive while the snapshot is being written go to both the old and the
+ * new file, so a crash at any point leaves a complete journal behind.
+ */
+class CMempoolJournal : public CValidationInterface
+{
+public:
+    explicit CMempoolJournal(const fs::path& pathIn);
+    ~CMempoolJournal();
+
+    /** Write a snapshot of the mempool as the new journal and start appending to it */
+    bool Start();
+    /** Stop the compaction thread and commit everything appended so far */
+    void Stop();
+    /** Whether a write error stopped journaling, so the journal misses later mempool changes */
+    bool IsFailed();
+
+    /** Replay the journal at path into entries in acceptance order, and the fee deltas of transactions not in it */
+    static bool Read(const fs::path& path, std::vector<MempoolDiskEntry>& entries, std::map<uint256, CAmount>& mapDeltas);
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx) override;
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
+
+    /** Rewrite the journal from a snapshot of the mempool and append to the new file */
+    bool Compact();
+
+private:
+    const fs::path path;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    std::thread thread;
+    FILE* file;
+    //! Size of the journal on disk
+    uint64_t nFileSize;
+    //! Set while a compaction is writing its snapshot
+    bool fCompacting;
+    //! Records appended while fCompacting, to be copied to the new journal
+    std::vector<unsigned char> vPending;
+    bool fStop;
+    bool fFailed;
+
+    void Append(const std::vector<unsigned char>& record);
+    void ThreadCompact();
+};
+
+extern std::unique_ptr<CMempoolJournal> g_mempool_journal;
+
+#endif // BITCOIN_MEMPOOLJOURNAL_H
@@ -28,6 +28,7 @@
 #include <validationinterface.h>
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <queue>
 #include <utility>
@@ -457,3 +458,360 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+CpuMiner::CpuMiner(int nThreadsIn) :
+    fInterrupt(false), nJob(0), nRunning(0), nJobEnd(0), nNextNonce(0), nFoundNonce(0),
+    vScratchpad(SCRYPT_MULTI_SCRATCHPAD_SIZE)
+{
+    for (int i = 1; i < nThreadsIn; i++) {
+        threads.emplace_back(&TraceThread<std::function<void()> >, "cpuminer", std::function<void()>(std::bind(&CpuMiner::ThreadMine, this)));
+    }
+}
+
+CpuMiner::~CpuMiner()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fInterrupt = true;
+    }
+    condWork.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+bool CpuMiner::Mine(CBlockHeader& header, uint32_t nNonceEnd, uint64_t& nMaxTries, const Consensus::Params& params)
+{
+    const uint64_t nStart = header.nNonce;
+    const uint64_t nEnd = std::min<uint64_t>(nNonceEnd, nStart + nMaxTries);
+    if (nStart >= nEnd)
+        return false;
+
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(header.nBits, &fNegative, &fOverflow);
+    if (fNegative || bnTarget == 0 || fOverflow || bnTarget > UintToArith256(params.powLimit)) {
+        // Like CheckProofOfWork, no hash satisfies an invalid target
+        nMaxTries -= nEnd - nStart;
+        header.nNonce = nEnd;
+        return false;
+    }
+
+    // Waking the workers only pays off if the block takes more than a
+    // batch per thread on average, which isn't the case on regtest
+    bool fParallel = !threads.empty() && (~bnTarget / (bnTarget + 1)) >= arith_uint256(CPU_MINER_BATCH_SIZE * (threads.size() + 1));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobHeader = header;
+        jobTarget = bnTarget;
+        nJobEnd = nEnd;
+        nNextNonce = nStart;
+        nFoundNonce = nEnd;
+        if (fParallel) {
+            nJob++;
+            nRunning = threads.size();
+        }
+    }
+    if (fParallel)
+        condWork.notify_all();
+
+    MineBatches(vScratchpad.data());
+
+    if (fParallel) {
+        std::unique_lock<std::mutex> lock(mutex);
+        condDone.wait(lock, [this] { return nRunning == 0; });
+    }
+
+    const uint64_t nFound = nFoundNonce;
+    nMaxTries -= nFound - nStart;
+    header.nNonce = nFound;
+    return nFound < nEnd;
+}
+
+void CpuMiner::ThreadMine()
+{
+    std::vector<char> scratchpad(SCRYPT_MULTI_SCRATCHPAD_SIZE);
+    uint64_t nLastJob = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condWork.wait(lock, [this, nLastJob] { return fInterrupt || nJob != nLastJob; });
+            if (fInterrupt)
+                return;
+            nLastJob = nJob;
+        }
+        MineBatches(scratchpad.data());
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--nRunning == 0)
+                condDone.notify_all();
+        }
+    }
+}
+
+void CpuMiner::MineBatches(char* scratchpad)
+{
+    CBlockHeader batch[CPU_MINER_BATCH_SIZE];
+    uint256 hashes[CPU_MINER_BATCH_SIZE];
+    for (uint32_t i = 0; i < CPU_MINER_BATCH_SIZE; i++)
+        batch[i] = jobHeader;
+
+    while (nFoundNonce == nJobEnd) {
+        const uint64_t nBatchStart = nNextNonce.fetch_add(CPU_MINER_BATCH_SIZE);
+        if (nBatchStart >= nJobEnd)
+            return;
+        const size_t nCount = std::min<uint64_t>(CPU_MINER_BATCH_SIZE, nJobEnd - nBatchStart);
+        for (size_t i = 0; i < nCount; i++)
+            batch[i].nNonce = nBatchStart + i;
+        static_assert(sizeof(CBlockHeader) == 80, "scrypt input must be the packed 80-byte header");
+        scrypt_1024_1_1_256_multi_sp((const char*)batch, (char*)hashes, nCount, scratchpad);
+        for (size_t i = 0; i < nCount; i++) {
+            if (UintToArith256(hashes[i]) <= jobTarget) {
+                uint64_t nFound = nFoundNonce;
+                while (nBatchStart + i < nFound && !nFoundNonce.compare_exchange_weak(nFound, nBatchStart + i)) {}
+                break;
+            }
+        }
+    }
+}
+
+std::unique_ptr<BlockTemplateCache> g_block_template_cache;
+
+BlockTemplateCache::BlockTemplateCache(const CChainParams& params) :
+    chainparams(params), fInterrupt(false), fTipChanged(false),
+    pindexTemplatePrev(nullptr), nTemplateTransactionsUpdated(0),
+    nTemplateWeight(0), nTemplateSigOpsCost(0), nTemplateFees(0), nTemplateHeight(0),
+    nTemplateLockTimeCutoff(0), fTemplateWitness(false), fStale(false), nLastRebuild(0)
+{
+    // Same limits as the BlockAssembler building the full templates
+    const BlockAssembler::Options options = DefaultOptions(params);
+    nBlockMaxWeight = std::max<size_t>(4000, std::min<size_t>(MAX_BLOCK_WEIGHT - 4000, options.nBlockMaxWeight));
+    blockMinFeeRate = options.blockMinFeeRate;
+}
+
+BlockTemplateCache::~BlockTemplateCache()
+{
+    Stop();
+}
+
+void BlockTemplateCache::Start()
+{
+    threadUpdate = std::thread(&TraceThread<std::function<void()> >, "tmplcache", std::function<void()>(std::bind(&BlockTemplateCache::ThreadUpdate, this)));
+}
+
+void BlockTemplateCache::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fInterrupt = true;
+    }
+    condWork.notify_all();
+    condTemplate.notify_all();
+    if (threadUpdate.joinable())
+        threadUpdate.join();
+}
+
+std::shared_ptr<const CBlockTemplate> BlockTemplateCache::GetTemplate(const CBlockIndex* pindexPrev, unsigned int& nTransactionsUpdated, int64_t nTimeoutMillis)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condTemplate.wait_for(lock, std::chrono::milliseconds(nTimeoutMillis), [this, pindexPrev] { return fInterrupt || pindexTemplatePrev == pindexPrev; });
+    if (!ptemplate || pindexTemplatePrev != pindexPrev)
+        return nullptr;
+    nTransactionsUpdated = nTemplateTransactionsUpdated;
+    return ptemplate;
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fTipChanged = true;
+    }
+    condWork.notify_one();
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        vAdded.push_back(ptx);
+    }
+    condWork.notify_one();
+}
+
+void BlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        vRemoved.push_back(ptx->GetHash());
+    }
+    condWork.notify_one();
+}
+
+void BlockTemplateCache::ThreadUpdate()
+{
+    while (true) {
+        std::vector<CTransactionRef> vtxAdded;
+        std::vector<uint256> vRemovedHashes;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Also wake up every second to rebuild a stale template
+            condWork.wait_for(lock, std::chrono::seconds(1), [this] { return fInterrupt || fTipChanged || !vAdded.empty() || !vRemoved.empty(); });
+            if (fInterrupt)
+                return;
+            fTipChanged = false;
+            vtxAdded.swap(vAdded);
+            vRemovedHashes.swap(vRemoved);
+        }
+
+        // getblocktemplate refuses to serve templates during the initial
+        // block download, so don't build one for every block connected.
+        if (IsInitialBlockDownload())
+            continue;
+
+        bool fRebuild;
+        {
+            LOCK(cs_main);
+            fRebuild = chainActive.Tip() != pindexTemplatePrev;
+        }
+        for (const uint256& hash : vRemovedHashes) {
+            if (setTemplateTx.count(hash))
+                fRebuild = true;
+        }
+        if (!fRebuild && !vtxAdded.empty())
+            fRebuild = !Append(vtxAdded);
+        if (!fRebuild && fStale && GetTime() - nLastRebuild >= BLOCK_TEMPLATE_REBUILD_INTERVAL)
+            fRebuild = true;
+        if (fRebuild)
+            Rebuild();
+    }
+}
+
+void BlockTemplateCache::Rebuild()
+{
+    nLastRebuild = GetTime();
+    fStale = false;
+
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    std::unique_ptr<CBlockTemplate> pnew;
+    try {
+        pnew = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE);
+    } catch (const std::exception& e) {
+        // Withdraw the current template; with no template on the tip the
+        // next wakeup tries again.
+        LogPrintf("%s: %s\n", __func__, e.what());
+        setTemplateTx.clear();
+        Publish(nullptr, nullptr, 0);
+        return;
+    }
+
+    const CBlockIndex* pindexPrev;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(pnew->block.hashPrevBlock);
+        assert(mi != mapBlockIndex.end());
+        pindexPrev = mi->second;
+    }
+
+    // Same accounting as BlockAssembler, which reserves room for the coinbase
+    setTemplateTx.clear();
+    nTemplateWeight = 4000;
+    nTemplateSigOpsCost = 400;
+    for (size_t i = 1; i < pnew->block.vtx.size(); i++) {
+        setTemplateTx.insert(pnew->block.vtx[i]->GetHash());
+        nTemplateWeight += GetTransactionWeight(*pnew->block.vtx[i]);
+        nTemplateSigOpsCost += pnew->vTxSigOpsCost[i];
+    }
+    nTemplateFees = -pnew->vTxFees[0];
+    nTemplateHeight = pindexPrev->nHeight + 1;
+    nTemplateLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                              ? pindexPrev->GetMedianTimePast()
+                              : pnew->block.GetBlockTime();
+    fTemplateWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+
+    Publish(std::move(pnew), pindexPrev, nTransactionsUpdated);
+}
+
+bool BlockTemplateCache::Append(const std::vector<CTransactionRef>& vtx)
+{
+    LOCK2(cs_main, mempool.cs);
+    if (!ptemplate || chainActive.Tip() != pindexTemplatePrev)
+        return false;
+
+    // Transactions leaving the mempool are reported too, but possibly only
+    // after the ones that replaced them arrived.
+    for (size_t i = 1; i < ptemplate->block.vtx.size(); i++) {
+        if (!mempool.exists(ptemplate->block.vtx[i]->GetHash()))
+            return false;
+    }
+
+    std::shared_ptr<CBlockTemplate> pnew;
+    for (const CTransactionRef& ptx : vtx) {
+        if (setTemplateTx.count(ptx->GetHash()))
+            continue;
+        CTxMemPool::txiter it = mempool.mapTx.find(ptx->GetHash());
+        if (it == mempool.mapTx.end())
+            continue;
+
+        // A transaction whose parents weren't selected would have to be
+        // considered as a package with them, which takes a full rebuild
+        bool fParentsIncluded = true;
+        for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+            if (!setTemplateTx.count(parent->GetTx().GetHash())) {
+                fParentsIncluded = false;
+                break;
+            }
+        }
+        if (!fParentsIncluded) {
+            fStale = true;
+            continue;
+        }
+        if (it->GetModifiedFee() < blockMinFeeRate.GetFee(it->GetTxSize()))
+            continue;
+        // Same limits as BlockAssembler::TestPackage. Once the template is
+        // full only the package selection can decide what to leave out.
+        if (nTemplateWeight + WITNESS_SCALE_FACTOR * it->GetTxSize() >= nBlockMaxWeight ||
+            nTemplateSigOpsCost + it->GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST) {
+            fStale = true;
+            continue;
+        }
+        if (!IsFinalTx(it->GetTx(), nTemplateHeight, nTemplateLockTimeCutoff))
+            continue;
+        if (!fTemplateWitness && it->GetTx().HasWitness())
+            continue;
+
+        if (!pnew)
+            pnew = std::make_shared<CBlockTemplate>(*ptemplate);
+        pnew->block.vtx.emplace_back(it->GetSharedTx());
+        pnew->vTxFees.push_back(it->GetFee());
+        pnew->vTxSigOpsCost.push_back(it->GetSigOpCost());
+        nTemplateWeight += it->GetTxWeight();
+        nTemplateSigOpsCost += it->GetSigOpCost();
+        nTemplateFees += it->GetFee();
+        setTemplateTx.insert(ptx->GetHash());
+    }
+    if (!pnew)
+        return true;
+
+    // Pay the new fees to the coinbase and commit to the new witnesses
+    CMutableTransaction coinbaseTx(*pnew->block.vtx[0]);
+    coinbaseTx.vout.resize(1);
+    coinbaseTx.vout[0].nValue = nTemplateFees + GetBlockSubsidy(nTemplateHeight, chainparams.GetConsensus());
+    pnew->block.vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
+    pnew->vchCoinbaseCommitment = GenerateCoinbaseCommitment(pnew->block, pindexTemplatePrev, chainparams.GetConsensus());
+    pnew->vTxFees[0] = -nTemplateFees;
+
+    // A stale template isn't current with everything the mempool has seen
+    Publish(std::move(pnew), pindexTemplatePrev, fStale ? nTemplateTransactionsUpdated : mempool.GetTransactionsUpdated());
+    return true;
+}
+
+void BlockTemplateCache::Publish(std::shared_ptr<const CBlockTemplate> pnew, const CBlockIndex* pindexPrev, unsigned int nTransactionsUpdated)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ptemplate = std::move(pnew);
+        pindexTemplatePrev = pindexPrev;
+        nTemplateTransactionsUpdated = nTransactionsUpdated;
+    }
+    condTemplate.notify_all();
+}
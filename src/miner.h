@@ -6,11 +6,19 @@
 #ifndef BITCOIN_MINER_H
 #define BITCOIN_MINER_H
 
+#include <arith_uint256.h>
+#include <policy/feerate.h>
 #include <primitives/block.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
 #include <stdint.h>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
@@ -21,6 +29,18 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Default for -blocktemplatecache */
+static const bool DEFAULT_BLOCK_TEMPLATE_CACHE = false;
+/** Seconds between full rebuilds of a cached template that new transactions couldn't be appended to */
+static const int64_t BLOCK_TEMPLATE_REBUILD_INTERVAL = 5;
+/** How long getblocktemplate waits for the cache to catch up with a new tip before building a template itself */
+static const int64_t BLOCK_TEMPLATE_CACHE_WAIT_MILLIS = 2000;
+/** Default for -genthreads, the number of threads generate and generatetoaddress grind nonces on */
+static const int DEFAULT_GENERATE_THREADS = 1;
+/** Maximum number of threads generate and generatetoaddress grind nonces on */
+static const int MAX_GENERATE_THREADS = 64;
+/** Nonces a mining thread hashes between checks whether another thread found the block */
+static const uint32_t CPU_MINER_BATCH_SIZE = 16;
 
 struct CBlockTemplate
 {
@@ -192,6 +212,139 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
 };
 
+/**
+ * Keeps a block template on the current tip ready for getblocktemplate, so
+ * that callers don't have to wait for CreateNewBlock.
+ *
+ * The template is rebuilt on the cache's own thread as soon as the tip
+ * changes or one of its transactions leaves the mempool. Transactions
+ * entering the mempool are appended to it while their in-mempool parents are
+ * already part of it and it has room left. Anything that would need the
+ * package selection to run again, like a transaction whose parents weren't
+ * selected or a full template, is picked up by a full rebuild at most every
+ * BLOCK_TEMPLATE_REBUILD_INTERVAL seconds, which is how often
+ * getblocktemplate used to rebuild.
+ *
+ * Templates pay to a dummy OP_TRUE output and may contain witness
+ * transactions, like the ones getblocktemplate creates for segwit clients.
+ */
+class BlockTemplateCache : public CValidationInterface
+{
+public:
+    explicit BlockTemplateCache(const CChainParams& params);
+    ~BlockTemplateCache();
+
+    void Start();
+    void Stop();
+
+    /**
+     * Return the template built on pindexPrev, waiting up to nTimeoutMillis
+     * for it if the cache hasn't caught up with that tip yet, or nullptr.
+     * nTransactionsUpdated receives the mempool's update counter the
+     * template is current with. Must not be called with cs_main held.
+     */
+    std::shared_ptr<const CBlockTemplate> GetTemplate(const CBlockIndex* pindexPrev, unsigned int& nTransactionsUpdated, int64_t nTimeoutMillis);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx) override;
+
+private:
+    const CChainParams& chainparams;
+    size_t nBlockMaxWeight;
+    CFeeRate blockMinFeeRate;
+
+    std::mutex mutex;
+    //! Signalled when there is work for the update thread
+    std::condition_variable condWork;
+    //! Signalled when a new template is published
+    std::condition_variable condTemplate;
+    bool fInterrupt;
+    std::thread threadUpdate;
+
+    // Events not yet seen by the update thread, guarded by mutex
+    bool fTipChanged;
+    std::vector<CTransactionRef> vAdded;
+    std::vector<uint256> vRemoved;
+
+    // The published template, guarded by mutex
+    std::shared_ptr<const CBlockTemplate> ptemplate;
+    const CBlockIndex* pindexTemplatePrev;
+    unsigned int nTemplateTransactionsUpdated;
+
+    // What the update thread knows about the published template
+    std::set<uint256> setTemplateTx;
+    uint64_t nTemplateWeight;
+    int64_t nTemplateSigOpsCost;
+    CAmount nTemplateFees;
+    int nTemplateHeight;
+    int64_t nTemplateLockTimeCutoff;
+    bool fTemplateWitness;
+    bool fStale;
+    int64_t nLastRebuild;
+
+    void ThreadUpdate();
+    /** Build a new template from scratch */
+    void Rebuild();
+    /** Append the given mempool transactions to the current template where possible. Returns false if it must be rebuilt. */
+    bool Append(const std::vector<CTransactionRef>& vtx);
+    void Publish(std::shared_ptr<const CBlockTemplate> pnew, const CBlockIndex* pindexPrev, unsigned int nTransactionsUpdated);
+};
+
+extern std::unique_ptr<BlockTemplateCache> g_block_template_cache;
+
+/**
+ * Grinds the nonce of block headers on a pool of threads that lives as long
+ * as the miner, each with its own scrypt scratchpad reused for every batch.
+ * The calling thread mines too, so a miner with one thread starts none.
+ *
+ * Threads claim batches of consecutive nonces in increasing order and
+ * always hash a batch they claimed to the end, so the nonce found is the
+ * lowest one in the range that satisfies the target: the same nonce a
+ * single thread trying them in order would find.
+ */
+class CpuMiner
+{
+public:
+    explicit CpuMiner(int nThreadsIn);
+    ~CpuMiner();
+
+    /**
+     * Try the nonces from header.nNonce up to but excluding nNonceEnd, at
+     * most nMaxTries of them. On success header.nNonce is set to the nonce
+     * found, otherwise to the first nonce not tried. nMaxTries is decreased
+     * by the number of nonces that didn't satisfy the target.
+     */
+    bool Mine(CBlockHeader& header, uint32_t nNonceEnd, uint64_t& nMaxTries, const Consensus::Params& params);
+
+private:
+    std::mutex mutex;
+    //! Signalled when a job is posted or the miner is shutting down
+    std::condition_variable condWork;
+    //! Signalled when the last worker is done with the current job
+    std::condition_variable condDone;
+    std::vector<std::thread> threads;
+    bool fInterrupt;
+    //! Sequence number of the current job and number of workers still on it, guarded by mutex
+    uint64_t nJob;
+    int nRunning;
+
+    // The current job, written under mutex before workers are woken
+    CBlockHeader jobHeader;
+    arith_uint256 jobTarget;
+    uint64_t nJobEnd;
+    std::atomic<uint64_t> nNextNonce;
+    //! Lowest nonce found so far, or nJobEnd
+    std::atomic<uint64_t> nFoundNonce;
+
+    std::vector<char> vScratchpad;
+
+    void ThreadMine();
+    /** Hash batches of the current job's nonces until they run out or one is found */
+    void MineBatches(char* scratchpad);
+};
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
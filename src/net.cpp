@@ -35,6 +35,10 @@
 #endif
 
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #include <math.h>
 
 // Dump addresses to peers.dat and banlist.dat every 15 minutes (900s)
@@ -73,6 +77,14 @@ enum BindFlags {
 
 const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
+/** How long the socket handler waits for socket events before checking the nodes again */
+static const int SELECT_TIMEOUT_MILLISECONDS = 50;
+
+#ifdef USE_EPOLL
+/** Most socket events handled per wakeup of the socket handler; the rest wait for the next one */
+static const int MAX_EPOLL_EVENTS = 1024;
+#endif
+
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
 //
@@ -1149,6 +1161,166 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+#ifdef USE_EPOLL
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            // Same policy as the select() backend below: drain the send
+            // buffer first, otherwise receive while there is room to.
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+            uint32_t events = 0;
+            if (select_send)
+                events = EPOLLOUT;
+            else if (select_recv)
+                events = EPOLLIN;
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            // Sockets are registered once and only touched again when the
+            // events of interest change. Closing a socket removes it from
+            // the epoll set, so nothing needs to be done on disconnect.
+            if (pnode->fEpollRegistered && pnode->nEpollEvents == events)
+                continue;
+
+            struct epoll_event event = {};
+            event.events = events;
+            event.data.fd = pnode->hSocket;
+            int op = pnode->fEpollRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            int nRet = epoll_ctl(epollfd, op, pnode->hSocket, &event);
+            if (nRet == SOCKET_ERROR && op == EPOLL_CTL_ADD && WSAGetLastError() == EEXIST)
+                nRet = epoll_ctl(epollfd, EPOLL_CTL_MOD, pnode->hSocket, &event);
+            if (nRet == SOCKET_ERROR) {
+                LogPrintf("socket epoll_ctl error %s, disconnecting peer=%d\n", NetworkErrorString(WSAGetLastError()), pnode->GetId());
+                pnode->fDisconnect = true;
+                continue;
+            }
+            pnode->fEpollRegistered = true;
+            pnode->nEpollEvents = events;
+        }
+    }
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, SELECT_TIMEOUT_MILLISECONDS);
+    if (nEvents == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+            interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        }
+        return;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        SOCKET hSocket = events[i].data.fd;
+        if (events[i].events & EPOLLIN)
+            recv_set.insert(hSocket);
+        if (events[i].events & EPOLLOUT)
+            send_set.insert(hSocket);
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            error_set.insert(hSocket);
+    }
+}
+#else
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    struct timeval timeout = MillisToTimeval(SELECT_TIMEOUT_MILLISECONDS);
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+    std::vector<SOCKET> vSockets;
+
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+        vSockets.push_back(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            FD_SET(pnode->hSocket, &fdsetError);
+            hSocketMax = std::max(hSocketMax, pnode->hSocket);
+            have_fds = true;
+            vSockets.push_back(pnode->hSocket);
+
+            if (select_send) {
+                FD_SET(pnode->hSocket, &fdsetSend);
+                continue;
+            }
+            if (select_recv) {
+                FD_SET(pnode->hSocket, &fdsetRecv);
+            }
+        }
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            recv_set.insert(vSockets.begin(), vSockets.end());
+        }
+        interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    for (SOCKET hSocket : vSockets) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+}
+#endif
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1218,91 +1390,17 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0)
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1333,9 +1431,9 @@ void CConnman::ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet)
             {
@@ -1356,11 +1454,16 @@ void CConnman::ThreadSocketHandler()
                     RecordBytesRecv(nBytes);
                     if (notify) {
                         size_t nSizeAdded = 0;
+                        std::vector<CNetMessage*> vPrepare;
                         auto it(pnode->vRecvMsg.begin());
                         for (; it != pnode->vRecvMsg.end(); ++it) {
                             if (!it->complete())
                                 break;
                             nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+                            if (nMessagePrepareThreads > 0 && it->hdr.nMessageSize >= MIN_MESSAGE_PREPARE_SIZE)
+                                vPrepare.push_back(&*it);
+                            else
+                                it->fPrepared = true;
                         }
                         {
                             LOCK(pnode->cs_vProcessMsg);
@@ -1368,6 +1471,8 @@ void CConnman::ThreadSocketHandler()
                             pnode->nProcessQueueSize += nSizeAdded;
                             pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
                         }
+                        if (!vPrepare.empty())
+                            QueueMessagesForPrepare(pnode, vPrepare);
                         WakeMessageHandler();
                     }
                 }
@@ -1993,6 +2098,55 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     }
 }
 
+void CConnman::QueueMessagesForPrepare(CNode* pnode, const std::vector<CNetMessage*>& msgs)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutexMsgPrepare);
+        for (CNetMessage* msg : msgs) {
+            // The reference keeps the node, and with it the message, alive
+            // until the message has been prepared.
+            pnode->AddRef();
+            queueMsgPrepare.emplace_back(pnode, msg);
+        }
+    }
+    condMsgPrepare.notify_all();
+}
+
+void CConnman::ThreadMessagePrepare()
+{
+    while (true)
+    {
+        std::pair<CNode*, CNetMessage*> item;
+        {
+            std::unique_lock<std::mutex> lock(mutexMsgPrepare);
+            condMsgPrepare.wait(lock, [this] { return flagInterruptMsgProc || !queueMsgPrepare.empty(); });
+            if (flagInterruptMsgProc)
+                return;
+            item = queueMsgPrepare.front();
+            queueMsgPrepare.pop_front();
+        }
+        CNode* pnode = item.first;
+        CNetMessage& msg = *item.second;
+
+        // The message stays at its place in vProcessMsg meanwhile, so the
+        // order in which a peer's messages are processed is unaffected; the
+        // message handler only waits for this peer when it reaches it.
+        if (!pnode->fDisconnect) {
+            msg.GetMessageHash();
+            m_msgproc->PrepareMessage(pnode, msg);
+        }
+        {
+            LOCK(pnode->cs_vProcessMsg);
+            msg.fPrepared = true;
+        }
+        {
+            LOCK(cs_vNodes);
+            pnode->Release();
+        }
+        WakeMessageHandler();
+    }
+}
+
 void CConnman::ThreadMessageHandler()
 {
     while (!flagInterruptMsgProc)
@@ -2204,6 +2358,10 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
     flagInterruptMsgProc = false;
+    nMessagePrepareThreads = 0;
+#ifdef USE_EPOLL
+    epollfd = -1;
+#endif
     SetTryNewOutboundPeer(false);
 
     Options connOptions;
@@ -2270,6 +2428,27 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         return false;
     }
 
+#ifdef USE_EPOLL
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        LogPrintf("epoll_create1 failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+        if (clientInterface) {
+            clientInterface->ThreadSafeMessageBox(
+                _("Failed to set up the network event queue."),
+                "", CClientUIInterface::MSG_ERROR);
+        }
+        return false;
+    }
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = hListenSocket.socket;
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) == SOCKET_ERROR) {
+            LogPrintf("epoll_ctl failed for listening socket with error %s\n", NetworkErrorString(WSAGetLastError()));
+        }
+    }
+#endif
+
     for (const auto& strDest : connOptions.vSeedNodes) {
         AddOneShot(strDest);
     }
@@ -2356,6 +2535,11 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     if (connOptions.m_use_addrman_outgoing || !connOptions.m_specified_outgoing.empty())
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
+    // Decode large messages ahead of processing
+    for (int i = 0; i < nMessagePrepareThreads; i++) {
+        threadMessagePrepare.emplace_back(&TraceThread<std::function<void()> >, "msgprep", std::function<void()>(std::bind(&CConnman::ThreadMessagePrepare, this)));
+    }
+
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
@@ -2387,6 +2571,11 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    {
+        // Notify under the lock so a preparation thread can't miss the flag
+        std::lock_guard<std::mutex> lock(mutexMsgPrepare);
+        condMsgPrepare.notify_all();
+    }
 
     interruptNet();
     InterruptSocks5(true);
@@ -2408,6 +2597,11 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (std::thread& thread : threadMessagePrepare) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessagePrepare.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2417,6 +2611,11 @@ void CConnman::Stop()
     if (threadSocketHandler.joinable())
         threadSocketHandler.join();
 
+    // Drop the references held by messages that were never prepared
+    for (const auto& item : queueMsgPrepare)
+        item.first->Release();
+    queueMsgPrepare.clear();
+
     if (fAddressesInitialized)
     {
         DumpData();
@@ -2430,6 +2629,12 @@ void CConnman::Stop()
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+#endif
 
     // clean up some globals (to help leak detection)
     for (CNode *pnode : vNodes) {
@@ -2742,6 +2947,10 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+#ifdef USE_EPOLL
+    fEpollRegistered = false;
+    nEpollEvents = 0;
+#endif
     nProcessQueueSize = 0;
 
     for (const std::string &msg : getAllNetMessageTypes())
@@ -15,6 +15,7 @@
 #include <limitedmap.h>
 #include <netaddress.h>
 #include <policy/feerate.h>
+#include <primitives/block.h>
 #include <protocol.h>
 #include <random.h>
 #include <streams.h>
@@ -35,6 +36,7 @@
 
 
 class CScheduler;
+class CNetMessage;
 class CNode;
 
 namespace boost {
@@ -83,6 +85,12 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** Default for -msgthreads, the number of threads decoding large messages ahead of the message handler */
+static const int DEFAULT_MESSAGE_PREPARE_THREADS = 2;
+/** Maximum number of threads decoding large messages ahead of the message handler */
+static const int MAX_MESSAGE_PREPARE_THREADS = 16;
+/** Messages with smaller payloads are handed straight to the message handler */
+static const unsigned int MIN_MESSAGE_PREPARE_SIZE = 1000;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
@@ -137,6 +145,7 @@ public:
         NetEventsInterface* m_msgproc = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        int nMessagePrepareThreads = 0;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         std::vector<std::string> vSeedNodes;
@@ -158,6 +167,7 @@ public:
         m_msgproc = connOptions.m_msgproc;
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
+        nMessagePrepareThreads = connOptions.nMessagePrepareThreads;
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -330,7 +340,11 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
+    void ThreadMessagePrepare();
+    void QueueMessagesForPrepare(CNode* pnode, const std::vector<CNetMessage*>& msgs);
     void AcceptConnection(const ListenSocket& hListenSocket);
+    /** Wait briefly for socket activity and collect the sockets that are ready */
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -385,8 +399,12 @@ private:
 
     unsigned int nSendBufferMaxSize;
     unsigned int nReceiveFloodSize;
+    int nMessagePrepareThreads;
 
     std::vector<ListenSocket> vhListenSocket;
+#ifdef USE_EPOLL
+    int epollfd;
+#endif
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned;
     CCriticalSection cs_setBanned;
@@ -425,6 +443,11 @@ private:
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
 
+    /** Received messages waiting to be decoded, each holding a reference to its node */
+    std::deque<std::pair<CNode*, CNetMessage*>> queueMsgPrepare;
+    std::condition_variable condMsgPrepare;
+    std::mutex mutexMsgPrepare;
+
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
@@ -432,6 +455,7 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessagePrepare;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -469,6 +493,8 @@ class NetEventsInterface
 public:
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
+    /** Decode a received message ahead of ProcessMessages. Called from the message preparation threads, never concurrently with ProcessMessages for the same message */
+    virtual void PrepareMessage(CNode* pnode, CNetMessage& msg) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
 };
@@ -569,12 +595,20 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    // Set once the message may be handed to ProcessMessages, guarded by the
+    // node's cs_vProcessMsg. Large messages are first decoded by the message
+    // preparation threads, which fill in pblock or ptx.
+    bool fPrepared;
+    std::shared_ptr<CBlock> pblock;
+    CTransactionRef ptx;
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fPrepared = false;
     }
 
     bool complete() const
@@ -660,6 +694,11 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+#ifdef USE_EPOLL
+    //! Socket handler state, guarded by cs_hSocket: whether hSocket is in the epoll set and with which events
+    bool fEpollRegistered;
+    uint32_t nEpollEvents;
+#endif
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -8,6 +8,7 @@
 #include <addrman.h>
 #include <arith_uint256.h>
 #include <blockencodings.h>
+#include <blockfilereader.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
@@ -712,6 +713,11 @@ void EraseOrphansFor(NodeId peer)
     if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased, peer);
 }
 
+size_t GetOrphanTxCount()
+{
+    LOCK(g_cs_orphans);
+    return mapOrphanTransactions.size();
+}
 
 unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
 {
@@ -1108,9 +1114,30 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
     // it's available before trying to send.
     if (send && (mi->second->nStatus & BLOCK_HAVE_DATA))
     {
+        // If a peer is asking for old blocks, we're almost guaranteed
+        // they won't have a useful mempool to match against a compact block,
+        // and we don't feel like constructing the object for them, so
+        // instead we respond with the full, non-compact block.
+        bool fSendCmpct = inv.type == MSG_CMPCT_BLOCK && CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+        bool fSendFullBlock = inv.type == MSG_BLOCK || inv.type == MSG_WITNESS_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fSendCmpct);
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (fSendFullBlock) {
+            // Send the bytes stored on disk as they are, rather than
+            // deserializing the block only to serialize it again
+            CRawBlock raw;
+            if (!ReadRawBlockFromDisk(raw, (*mi).second))
+                assert(!"cannot load block from disk");
+            bool fPeerWantsWitness = inv.type == MSG_WITNESS_BLOCK || (inv.type == MSG_CMPCT_BLOCK && State(pfrom->GetId())->fWantsCmpctWitness);
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            if (fPeerWantsWitness) {
+                msg.data.assign(raw.begin(), raw.end());
+            } else if (!raw.GetWithoutWitness(msg.data)) {
+                assert(!"cannot parse block from disk");
+            }
+            connman->PushMessage(pfrom, std::move(msg));
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1118,7 +1145,9 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
                 assert(!"cannot load block from disk");
             pblock = pblockRead;
         }
-        if (inv.type == MSG_BLOCK)
+        if (!pblock) {
+            // Already sent from its stored bytes
+        } else if (inv.type == MSG_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
         else if (inv.type == MSG_WITNESS_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
@@ -1150,13 +1179,9 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
         }
         else if (inv.type == MSG_CMPCT_BLOCK)
         {
-            // If a peer is asking for old blocks, we're almost guaranteed
-            // they won't have a useful mempool to match against a compact block,
-            // and we don't feel like constructing the object for them, so
-            // instead we respond with the full, non-compact block.
             bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-            if (CanDirectFetch(consensusParams) && mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+            if (fSendCmpct) {
                 if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == mi->second->GetBlockHash()) {
                     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                 } else {
@@ -1490,7 +1515,8 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
-bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
+bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc,
+                           std::shared_ptr<CBlock> pblockDecoded = nullptr, CTransactionRef ptxDecoded = nullptr)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
     if (gArgs.IsArgSet("-dropmessagestest") && GetRand(gArgs.GetArg("-dropmessagestest", 0)) == 0)
@@ -2116,8 +2142,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         std::deque<COutPoint> vWorkQueue;
         std::vector<uint256> vEraseQueue;
-        CTransactionRef ptx;
-        vRecv >> ptx;
+        CTransactionRef ptx = std::move(ptxDecoded);
+        if (!ptx)
+            vRecv >> ptx;
         const CTransaction& tx = *ptx;
 
         CInv inv(MSG_TX, tx.GetHash());
@@ -2617,8 +2644,11 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
+        std::shared_ptr<CBlock> pblock = std::move(pblockDecoded);
+        if (!pblock) {
+            pblock = std::make_shared<CBlock>();
+            vRecv >> *pblock;
+        }
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
@@ -2915,6 +2945,9 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // Wait for the message preparation threads to finish with it
+        if (!pfrom->vProcessMsg.front().fPrepared)
+            return false;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
@@ -2959,7 +2992,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     bool fRet = false;
     try
     {
-        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
+        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, std::move(msg.pblock), std::move(msg.ptx));
         if (interruptMsgProc)
             return false;
         if (!pfrom->vRecvGetData.empty())
@@ -3004,6 +3037,42 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     return fMoreWork;
 }
 
+void PeerLogicValidation::PrepareMessage(CNode* pfrom, CNetMessage& msg)
+{
+    // Anything sent before the handshake completes is rejected without
+    // looking at its payload, and so are blocks while importing.
+    if (!pfrom->fSuccessfullyConnected)
+        return;
+    const std::string strCommand = msg.hdr.GetCommand();
+    const bool fBlock = strCommand == NetMsgType::BLOCK;
+    if (!fBlock && strCommand != NetMsgType::TX)
+        return;
+    if (fBlock && (fImporting || fReindex))
+        return;
+    if (memcmp(msg.GetMessageHash().begin(), msg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+        return;
+
+    // Decode from a copy, so that ProcessMessage sees the payload untouched
+    // and reports malformed messages as it always has.
+    CDataStream vRecv(msg.vRecv.begin(), msg.vRecv.end(), msg.vRecv.GetType(), pfrom->GetRecvVersion());
+    try {
+        if (fBlock) {
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            vRecv >> *pblock;
+            // Run the context-free checks now; a pass is remembered in
+            // fChecked so ProcessNewBlock doesn't repeat them under cs_main,
+            // and a failure is found and handled again there.
+            CValidationState state;
+            CheckBlock(*pblock, state, Params().GetConsensus());
+            msg.pblock = std::move(pblock);
+        } else {
+            vRecv >> msg.ptx;
+        }
+    } catch (const std::exception&) {
+        msg.ptx = nullptr;
+    }
+}
+
 void PeerLogicValidation::ConsiderEviction(CNode *pto, int64_t time_in_seconds)
 {
     AssertLockHeld(cs_main);
@@ -52,6 +52,8 @@ public:
     void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) override;
     /** Process protocol messages received from a given node */
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
+    /** Decode large block and transaction messages and run the context-free block checks, off the message handler thread */
+    void PrepareMessage(CNode* pfrom, CNetMessage& msg) override;
     /**
     * Send queued protocol messages to be sent to a give node.
     *
@@ -80,5 +82,7 @@ struct CNodeStateStats {
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
+/** Number of transactions in the orphan pool */
+size_t GetOrphanTxCount();
 
 #endif // BITCOIN_NET_PROCESSING_H
@@ -659,6 +659,8 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
 
     trackedTxs = 0;
     untrackedTxs = 0;
+
+    std::atomic_store(&smartFeeTable, std::shared_ptr<SmartFeeTable>());
 }
 
 CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget) const
@@ -819,7 +821,41 @@ double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget,
  */
 CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
 {
+    std::shared_ptr<SmartFeeTable> table = std::atomic_load(&smartFeeTable);
+    if (table && confTarget > 0 && (size_t)confTarget < table->size()) {
+        const CachedEstimate& estimate = (*table)[confTarget][conservative];
+        if (estimate.fFilled.load(std::memory_order_acquire)) {
+            if (feeCalc) {
+                *feeCalc = estimate.calc;
+                feeCalc->desiredTarget = confTarget;
+            }
+            return estimate.feeRate;
+        }
+    }
+
     LOCK(cs_feeEstimator);
+    table = std::atomic_load(&smartFeeTable);
+    if (!table) {
+        table = std::make_shared<SmartFeeTable>(longStats->GetMaxConfirms() + 1);
+        std::atomic_store(&smartFeeTable, table);
+    }
+    if (confTarget <= 0 || (size_t)confTarget >= table->size())
+        return estimateSmartFeeLocked(confTarget, feeCalc, conservative);
+    CachedEstimate& estimate = (*table)[confTarget][conservative];
+    if (!estimate.fFilled.load(std::memory_order_relaxed)) {
+        estimate.feeRate = estimateSmartFeeLocked(confTarget, &estimate.calc, conservative);
+        estimate.fFilled.store(true, std::memory_order_release);
+    }
+    if (feeCalc) {
+        *feeCalc = estimate.calc;
+        feeCalc->desiredTarget = confTarget;
+    }
+    return estimate.feeRate;
+}
+
+CFeeRate CBlockPolicyEstimator::estimateSmartFeeLocked(int confTarget, FeeCalculation *feeCalc, bool conservative) const
+{
+    AssertLockHeld(cs_feeEstimator);
 
     if (feeCalc) {
         feeCalc->desiredTarget = confTarget;
@@ -895,7 +931,6 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
     return CFeeRate(llround(median));
 }
 
-
 bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
     try {
@@ -972,6 +1007,7 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
+            std::atomic_store(&smartFeeTable, std::shared_ptr<SmartFeeTable>());
         }
     }
     catch (const std::exception& e) {
@@ -11,6 +11,8 @@
 #include <random.h>
 #include <sync.h>
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -256,8 +258,6 @@ private:
     std::vector<double> buckets;              // The upper-bound of the range for the bucket (inclusive)
     std::map<double, unsigned int> bucketMap; // Map of bucket upper-bound to index into all vectors by bucket
 
-    mutable CCriticalSection cs_feeEstimator;
-
     /** Process a transaction confirmed in a block*/
     bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry);
 
@@ -271,6 +271,31 @@ private:
     unsigned int HistoricalBlockSpan() const;
     /** Calculation of highest target that reasonable estimate can be provided for */
     unsigned int MaxUsableEstimate() const;
+
+    struct CachedEstimate
+    {
+        //! Set once feeRate and calc hold the estimate, which then never changes
+        std::atomic<bool> fFilled{false};
+        CFeeRate feeRate;
+        FeeCalculation calc;
+    };
+    /** Smart fee estimates indexed by target, economical then conservative */
+    typedef std::vector<std::array<CachedEstimate, 2> > SmartFeeTable;
+    /**
+     * The results of estimateSmartFee since the last block was processed.
+     * Each one is computed under cs_feeEstimator when it is first asked
+     * for, and served without waiting for the lock afterwards. Estimates
+     * only depend on the data of past blocks, except for transactions
+     * leaving the mempool unconfirmed. Only accessed through
+     * std::atomic_load and std::atomic_store; null until the first request.
+     */
+    mutable std::shared_ptr<SmartFeeTable> smartFeeTable;
+
+protected:
+    mutable CCriticalSection cs_feeEstimator;
+
+    /** estimateSmartFee for callers holding cs_feeEstimator, bypassing smartFeeTable */
+    CFeeRate estimateSmartFeeLocked(int confTarget, FeeCalculation *feeCalc, bool conservative) const;
 };
 
 class FeeFilterRounder
@@ -23,6 +23,21 @@ uint256 CBlockHeader::GetPoWHash() const
     return thash;
 }
 
+std::vector<uint256> GetPoWHashes(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<uint256> hashes(headers.size());
+    GetPoWHashes(headers.data(), headers.size(), hashes.data());
+    return hashes;
+}
+
+void GetPoWHashes(const CBlockHeader* headers, size_t count, uint256* hashes)
+{
+    static_assert(sizeof(CBlockHeader) == 80, "scrypt input must be the packed 80-byte header");
+    if (count > 0) {
+        scrypt_1024_1_1_256_multi((const char*)headers, (char*)hashes, count);
+    }
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
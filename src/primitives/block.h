@@ -70,6 +70,10 @@ public:
     }
 };
 
+/** Compute the scrypt PoW hashes of a batch of headers, several at a time where the CPU allows. */
+std::vector<uint256> GetPoWHashes(const std::vector<CBlockHeader>& headers);
+void GetPoWHashes(const CBlockHeader* headers, size_t count, uint256* hashes);
+
 
 class CBlock : public CBlockHeader
 {
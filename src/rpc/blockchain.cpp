@@ -6,6 +6,7 @@
 #include <rpc/blockchain.h>
 
 #include <amount.h>
+#include <blockfilereader.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -16,7 +17,9 @@
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
+#include <stats/stats.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
@@ -161,6 +164,40 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+void blockToJSONStream(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    UniValue result;
+    {
+        LOCK(cs_main);
+        result = blockToJSON(block, blockindex, false);
+    }
+    if (!txDetails) {
+        writer.Value(result);
+        return;
+    }
+
+    // Same layout as blockToJSON, but the transactions are built and
+    // written one at a time
+    writer.BeginObject();
+    const std::vector<std::string>& keys = result.getKeys();
+    const std::vector<UniValue>& values = result.getValues();
+    for (size_t i = 0; i < keys.size(); i++) {
+        writer.Key(keys[i]);
+        if (keys[i] != "tx") {
+            writer.Value(values[i]);
+            continue;
+        }
+        writer.BeginArray();
+        for (const auto& tx : block.vtx) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
+            writer.Value(objTx);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -372,6 +409,9 @@ std::string EntryDescriptionString()
            "    \"ancestorcount\" : n,    (numeric) number of in-mempool ancestor transactions (including this one)\n"
            "    \"ancestorsize\" : n,     (numeric) virtual transaction size of in-mempool ancestors (including this one)\n"
            "    \"ancestorfees\" : n,     (numeric) modified fees (see above) of in-mempool ancestors (including this one)\n"
+           "    \"clustercount\" : n,     (numeric) number of in-mempool transactions connected to this one (including this one)\n"
+           "    \"clustersize\" : n,      (numeric) virtual transaction size of those transactions\n"
+           "    \"clusterfees\" : n,      (numeric) modified fees (see above) of those transactions\n"
            "    \"wtxid\" : hash,         (string) hash of serialized transaction, including witness data\n"
            "    \"depends\" : [           (array) unconfirmed transactions used as inputs for this transaction\n"
            "        \"transactionid\",    (string) parent transaction id\n"
@@ -393,6 +433,12 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.push_back(Pair("ancestorcount", e.GetCountWithAncestors()));
     info.push_back(Pair("ancestorsize", e.GetSizeWithAncestors()));
     info.push_back(Pair("ancestorfees", e.GetModFeesWithAncestors()));
+    uint64_t nClusterCount, nClusterSize;
+    CAmount nClusterFees;
+    mempool.GetClusterState(e, nClusterCount, nClusterSize, nClusterFees);
+    info.push_back(Pair("clustercount", nClusterCount));
+    info.push_back(Pair("clustersize", nClusterSize));
+    info.push_back(Pair("clusterfees", nClusterFees));
     info.push_back(Pair("wtxid", mempool.vTxHashes[e.vTxHashesIdx].first.ToString()));
     const CTransaction& tx = e.GetTx();
     std::set<std::string> setDepends;
@@ -411,6 +457,39 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.push_back(Pair("depends", depends));
 }
 
+void mempoolToJSONStream(JSONStreamWriter& writer)
+{
+    // Writing waits for slow clients, so the entries are built in batches
+    // under mempool.cs and written once it is released. Transactions that
+    // leave the mempool before their batch is built are left out.
+    std::vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+    std::vector<std::pair<std::string, UniValue>> batch;
+    writer.BeginObject();
+    for (size_t i = 0; i < vtxid.size(); i += MEMPOOL_JSON_STREAM_BATCH_SIZE)
+    {
+        batch.clear();
+        {
+            LOCK(mempool.cs);
+            for (size_t j = i; j < std::min(vtxid.size(), i + MEMPOOL_JSON_STREAM_BATCH_SIZE); j++)
+            {
+                CTxMemPool::txiter it = mempool.mapTx.find(vtxid[j]);
+                if (it == mempool.mapTx.end())
+                    continue;
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(info, *it);
+                batch.emplace_back(vtxid[j].ToString(), std::move(info));
+            }
+        }
+        for (const auto& entry : batch)
+        {
+            writer.Key(entry.first);
+            writer.Value(entry.second);
+        }
+    }
+    writer.EndObject();
+}
+
 UniValue mempoolToJSON(bool fVerbose)
 {
     if (fVerbose)
@@ -790,6 +869,15 @@ UniValue getblock(const JSONRPCRequest& request)
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
+    if (verbosity <= 0 && RPCSerializationFlags() == 0)
+    {
+        // Blocks are stored in the serialization asked for, return it as is
+        CRawBlock raw;
+        if (!ReadRawBlockFromDisk(raw, pblockindex))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        return HexStr(raw.begin(), raw.end());
+    }
+
     if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
@@ -1381,6 +1469,22 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("mempoolminfee", ValueFromAmount(std::max(mempool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK())));
     ret.push_back(Pair("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK())));
 
+    FeeHistogram feeHistogram, ancestorFeeHistogram;
+    mempool.GetFeeHistograms(feeHistogram, ancestorFeeHistogram);
+    UniValue histogram(UniValue::VARR);
+    for (int i = 0; i < FEE_HISTOGRAM_BUCKETS; i++) {
+        UniValue bucket(UniValue::VOBJ);
+        bucket.push_back(Pair("feerate", ValueFromAmount(FEE_HISTOGRAM_LIMITS[i])));
+        bucket.push_back(Pair("count", feeHistogram[i].nCount));
+        bucket.push_back(Pair("size", feeHistogram[i].nSize));
+        bucket.push_back(Pair("fees", ValueFromAmount(feeHistogram[i].nFees)));
+        bucket.push_back(Pair("ancestorcount", ancestorFeeHistogram[i].nCount));
+        bucket.push_back(Pair("ancestorsize", ancestorFeeHistogram[i].nSize));
+        bucket.push_back(Pair("ancestorfees", ValueFromAmount(ancestorFeeHistogram[i].nFees)));
+        histogram.push_back(bucket);
+    }
+    ret.push_back(Pair("feehistogram", histogram));
+
     return ret;
 }
 
@@ -1398,6 +1502,17 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
+            "  \"feehistogram\": [            (array) Mempool transactions by feerate, one entry per bucket\n"
+            "    {\n"
+            "      \"feerate\": xxxxx,          (numeric) Lower bound of the bucket in " + CURRENCY_UNIT + "/kB\n"
+            "      \"count\": xxxxx,            (numeric) Number of transactions whose modified feerate is in the bucket\n"
+            "      \"size\": xxxxx,             (numeric) Virtual size of those transactions\n"
+            "      \"fees\": xxxxx,             (numeric) Modified fees of those transactions in " + CURRENCY_UNIT + "\n"
+            "      \"ancestorcount\": xxxxx,    (numeric) Number of transactions whose feerate with ancestors is in the bucket\n"
+            "      \"ancestorsize\": xxxxx,     (numeric) Virtual size of those transactions, not counting their ancestors\n"
+            "      \"ancestorfees\": xxxxx      (numeric) Modified fees of those transactions in " + CURRENCY_UNIT + ", not counting their ancestors\n"
+            "    }, ...\n"
+            "  ]\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -1407,6 +1522,86 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+UniValue getmempoolstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 3)
+        throw std::runtime_error(
+            "getmempoolstats ( resolution from to )\n"
+            "\nReturns the history of the mempool collected with -mempoolstats.\n"
+            "Samples are kept for the last hour at 1 second resolution, the last day at 1 minute\n"
+            "resolution and the last 30 days at 1 hour resolution. Gauges are averaged over each\n"
+            "sample, counters are summed.\n"
+            "\nArguments:\n"
+            "1. resolution    (numeric, optional, default=60) Seconds per sample: 1, 60 or 3600\n"
+            "2. from          (numeric, optional, default=0) Only return samples from this time on (seconds since epoch)\n"
+            "3. to            (numeric, optional, default=0) Only return samples up to this time, 0 for no limit\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"resolution\": n,            (numeric) Seconds per sample\n"
+            "  \"feerate_buckets\": [ x, ... ], (array) Lower bound of each feerate histogram bucket in " + CURRENCY_UNIT + "/kB\n"
+            "  \"samples\": [\n"
+            "    {\n"
+            "      \"time\": n,              (numeric) Start of the sample in seconds since epoch\n"
+            "      \"size\": n,              (numeric) Transaction count\n"
+            "      \"usage\": n,             (numeric) Memory usage of the mempool\n"
+            "      \"mempoolminfee\": x,     (numeric) Minimum mempool fee rate in " + CURRENCY_UNIT + "/kB\n"
+            "      \"orphans\": n,           (numeric) Transactions in the orphan pool\n"
+            "      \"txpersec\": x,          (numeric) Transactions accepted to the mempool per second\n"
+            "      \"bytesrecv\": n,         (numeric) Bytes received from peers during the sample\n"
+            "      \"bytessent\": n,         (numeric) Bytes sent to peers during the sample\n"
+            "      \"feerate_histogram\": [ n, ... ] (array) Virtual size of the transactions in each feerate bucket\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmempoolstats", "")
+            + HelpExampleCli("getmempoolstats", "3600")
+            + HelpExampleRpc("getmempoolstats", "1, 1577836800")
+        );
+
+    if (!CStats::m_stats_enabled)
+        throw JSONRPCError(RPC_MISC_ERROR, "Mempool statistics are disabled, start with -mempoolstats to collect them");
+
+    uint32_t resolution = request.params[0].isNull() ? 60 : request.params[0].get_int();
+    uint64_t fromTime = request.params[1].isNull() ? 0 : std::max<int64_t>(request.params[1].get_int64(), 0);
+    uint64_t toTime = request.params[2].isNull() ? 0 : std::max<int64_t>(request.params[2].get_int64(), 0);
+    if (fromTime != 0 && toTime == 0)
+        toTime = std::numeric_limits<uint64_t>::max();
+
+    mempoolSamples_t samples;
+    if (!CStats::DefaultStats()->mempoolGetValuesInRange(resolution, fromTime, toTime, samples))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid resolution");
+    uint64_t startTime = CStats::DefaultStats()->mempoolStartTime();
+
+    UniValue buckets(UniValue::VARR);
+    for (int i = 0; i < STATS_FEERATE_BUCKETS; i++)
+        buckets.push_back(ValueFromAmount(FEE_HISTOGRAM_LIMITS[i]));
+
+    UniValue result(UniValue::VARR);
+    for (const CStatsMempoolSample& sample : samples) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("time", (int64_t)(startTime + sample.m_time_delta)));
+        obj.push_back(Pair("size", sample.m_tx_count));
+        obj.push_back(Pair("usage", sample.m_dyn_mem_usage));
+        obj.push_back(Pair("mempoolminfee", ValueFromAmount(sample.m_min_fee_per_k)));
+        obj.push_back(Pair("orphans", sample.m_orphan_count));
+        obj.push_back(Pair("txpersec", (double)sample.m_tx_accepted / resolution));
+        obj.push_back(Pair("bytesrecv", sample.m_bytes_recv));
+        obj.push_back(Pair("bytessent", sample.m_bytes_sent));
+        UniValue histogram(UniValue::VARR);
+        for (int64_t vsize : sample.m_feerate_vsize)
+            histogram.push_back(vsize);
+        obj.push_back(Pair("feerate_histogram", histogram));
+        result.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("resolution", (int64_t)resolution));
+    ret.push_back(Pair("feerate_buckets", buckets));
+    ret.push_back(Pair("samples", result));
+    return ret;
+}
+
 UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1634,6 +1829,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
+    { "blockchain",         "getmempoolstats",        &getmempoolstats,        {"resolution","from","to"} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(Sink sinkIn, size_t nChunkSizeIn) :
+    sink(std::move(sinkIn)), nChunkSize(nChunkSizeIn), fAfterKey(false)
+{
+    buffer.reserve(nChunkSize);
+}
+
+void JSONStreamWriter::Separator()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vFirst.empty()) {
+        if (!vFirst.back())
+            buffer += ',';
+        vFirst.back() = false;
+    }
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (buffer.size() >= nChunkSize)
+        Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separator();
+    buffer += '{';
+    vFirst.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    buffer += '}';
+    vFirst.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separator();
+    buffer += '[';
+    vFirst.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    buffer += ']';
+    vFirst.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!fAfterKey);
+    Separator();
+    buffer += UniValue(key).write();
+    buffer += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    if (value.isObject()) {
+        BeginObject();
+        const std::vector<std::string>& keys = value.getKeys();
+        const std::vector<UniValue>& values = value.getValues();
+        for (size_t i = 0; i < keys.size(); i++) {
+            Key(keys[i]);
+            Value(values[i]);
+        }
+        EndObject();
+    } else if (value.isArray()) {
+        BeginArray();
+        for (const UniValue& entry : value.getValues()) {
+            Value(entry);
+        }
+        EndArray();
+    } else {
+        RawValue(value.write());
+    }
+}
+
+void JSONStreamWriter::RawValue(const std::string& json)
+{
+    Separator();
+    buffer += json;
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Raw(const std::string& text)
+{
+    buffer += text;
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (!buffer.empty()) {
+        sink(buffer);
+        buffer.clear();
+    }
+}
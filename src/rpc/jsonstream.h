@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Size of the pieces handed to the sink of a JSONStreamWriter */
+static const size_t DEFAULT_JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Incremental JSON writer. Output is produced in the same compact format as
+ * UniValue::write(), but is handed to a sink in pieces of about nChunkSize
+ * bytes, so large documents never have to be held as one string.
+ *
+ * Values are written by alternating Key() and Value() inside objects, and
+ * by calling Value() repeatedly inside arrays. Nested containers can be
+ * opened with BeginObject()/BeginArray() so that their members never have
+ * to exist as a UniValue tree at the same time.
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    explicit JSONStreamWriter(Sink sinkIn, size_t nChunkSizeIn = DEFAULT_JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Write the key of the next object member */
+    void Key(const std::string& key);
+
+    /** Write a value, descending into arrays and objects member by member */
+    void Value(const UniValue& value);
+
+    /** Write an already serialized JSON value */
+    void RawValue(const std::string& json);
+
+    /** Append text outside of the JSON structure, such as a trailing newline */
+    void Raw(const std::string& text);
+
+    /** Hand everything buffered so far to the sink */
+    void Flush();
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string buffer;
+    //! One entry per open container, true until its first member is written
+    std::vector<bool> vFirst;
+    bool fAfterKey;
+
+    void Separator();
+    void MaybeFlush();
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
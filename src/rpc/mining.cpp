@@ -29,6 +29,18 @@
 #include <memory>
 #include <stdint.h>
 
+int ParseGenerateThreads(const UniValue& value)
+{
+    int nThreads = value.isNull() ? gArgs.GetArg("-genthreads", DEFAULT_GENERATE_THREADS) : value.get_int();
+    if (nThreads < 0 || nThreads > MAX_GENERATE_THREADS) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid threads, must be between %d - %d", 0, MAX_GENERATE_THREADS));
+    }
+    if (nThreads == 0) {
+        nThreads = std::max(1, std::min(GetNumCores(), MAX_GENERATE_THREADS));
+    }
+    return nThreads;
+}
+
 unsigned int ParseConfirmTarget(const UniValue& value)
 {
     int target = value.get_int();
@@ -103,7 +115,7 @@ UniValue getnetworkhashps(const JSONRPCRequest& request)
     return GetNetworkHashPS(!request.params[0].isNull() ? request.params[0].get_int() : 120, !request.params[1].isNull() ? request.params[1].get_int() : -1);
 }
 
-UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript)
+UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript, int nThreads)
 {
     static const int nInnerLoopCount = 0x10000;
     int nHeightEnd = 0;
@@ -114,6 +126,7 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         nHeight = chainActive.Height();
         nHeightEnd = nHeight+nGenerate;
     }
+    CpuMiner miner(nThreads);
     unsigned int nExtraNonce = 0;
     UniValue blockHashes(UniValue::VARR);
     while (nHeight < nHeightEnd)
@@ -126,10 +139,7 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
+        miner.Mine(*pblock, nInnerLoopCount, nMaxTries, Params().GetConsensus());
         if (nMaxTries == 0) {
             break;
         }
@@ -153,14 +163,15 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
 
 UniValue generatetoaddress(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 4)
         throw std::runtime_error(
-            "generatetoaddress nblocks address (maxtries)\n"
+            "generatetoaddress nblocks address (maxtries threads)\n"
             "\nMine blocks immediately to a specified address (before the RPC call returns)\n"
             "\nArguments:\n"
             "1. nblocks      (numeric, required) How many blocks are generated immediately.\n"
             "2. address      (string, required) The address to send the newly generated beyondcoin to.\n"
             "3. maxtries     (numeric, optional) How many iterations to try (default = 1000000).\n"
+            "4. threads      (numeric, optional) How many threads to mine on, 0 for one per core (default = -genthreads).\n"
             "\nResult:\n"
             "[ blockhashes ]     (array) hashes of blocks generated\n"
             "\nExamples:\n"
@@ -173,6 +184,7 @@ UniValue generatetoaddress(const JSONRPCRequest& request)
     if (!request.params[2].isNull()) {
         nMaxTries = request.params[2].get_int();
     }
+    int nThreads = ParseGenerateThreads(request.params[3]);
 
     CTxDestination destination = DecodeDestination(request.params[1].get_str());
     if (!IsValidDestination(destination)) {
@@ -182,7 +194,7 @@ UniValue generatetoaddress(const JSONRPCRequest& request)
     std::shared_ptr<CReserveScript> coinbaseScript = std::make_shared<CReserveScript>();
     coinbaseScript->reserveScript = GetScriptForDestination(destination);
 
-    return generateBlocks(coinbaseScript, nGenerate, nMaxTries, false);
+    return generateBlocks(coinbaseScript, nGenerate, nMaxTries, false, nThreads);
 }
 
 UniValue getmininginfo(const JSONRPCRequest& request)
@@ -504,13 +516,33 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     // Update block
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    static std::shared_ptr<const CBlockTemplate> pblocktemplate;
     // Cache whether the last invocation was with segwit support, to avoid returning
     // a segwit-block to a non-segwit caller.
     static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
+
+    // Templates kept up to date by -blocktemplatecache are built for segwit clients
+    std::shared_ptr<const CBlockTemplate> pcachedtemplate;
+    if (g_block_template_cache && fSupportsSegwit) {
+        CBlockIndex* pindexTip = chainActive.Tip();
+        unsigned int nTemplateTransactionsUpdated = 0;
+        // Right after a new block the template is usually still being built
+        LEAVE_CRITICAL_SECTION(cs_main);
+        pcachedtemplate = g_block_template_cache->GetTemplate(pindexTip, nTemplateTransactionsUpdated, BLOCK_TEMPLATE_CACHE_WAIT_MILLIS);
+        ENTER_CRITICAL_SECTION(cs_main);
+        if (pcachedtemplate && pindexTip == chainActive.Tip()) {
+            pblocktemplate = pcachedtemplate;
+            pindexPrev = pindexTip;
+            nTransactionsUpdatedLast = nTemplateTransactionsUpdated;
+            nStart = GetTime();
+            fLastTemplateSupportsSegwit = true;
+        } else {
+            pcachedtemplate.reset();
+        }
+    }
+    if (!pcachedtemplate && (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        fLastTemplateSupportsSegwit != fSupportsSegwit)
+        fLastTemplateSupportsSegwit != fSupportsSegwit))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -530,7 +562,9 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
         // Need to update only after we know CreateNewBlock succeeded
         pindexPrev = pindexPrevNew;
     }
-    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
+    // The template may be shared with other callers, so work on a copy of the block
+    CBlock block(pblocktemplate->block);
+    CBlock* pblock = &block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
 
     // Update nTime
@@ -984,7 +1018,7 @@ static const CRPCCommand commands[] =
     { "mining",             "submitblock",            &submitblock,            {"hexdata","dummy"} },
 
 
-    { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries"} },
+    { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries","threads"} },
 
     { "util",               "estimatefee",            &estimatefee,            {"nblocks"} },
     { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode"} },
@@ -254,36 +254,49 @@ UniValue validateaddress(const JSONRPCRequest& request)
     return ret;
 }
 
+static void getAddressFromString(const std::string& str, std::vector<std::pair<uint160, int> > &addresses)
+{
+    CTxDestination dest = DecodeDestination(str);
+    CScript scriptPubKey = GetScriptForDestination(dest);
+    uint160 hashBytes;
+    int addressType = 0;
+
+    if (scriptPubKey.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector <unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.begin() + 22));
+        addressType = 2;
+    } else if (scriptPubKey.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector <unsigned char>(scriptPubKey.begin() + 3, scriptPubKey.begin() + 23));
+        addressType = 1;
+    } else if (scriptPubKey.IsPayToWitnessPubkeyHash()) {
+        hashBytes = uint160(std::vector <unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.end()));
+        addressType = 1;
+    } else if (scriptPubKey.IsPayToWitnessScriptHash()) {
+        hashBytes = Hash160(std::vector <unsigned char> (scriptPubKey.begin() + 2, scriptPubKey.end()));
+        addressType = 2;
+    } else {
+        hashBytes.SetNull();
+        addressType = 0;
+    }
+
+    if (addressType == 0) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    addresses.push_back(std::make_pair(hashBytes, addressType));
+}
+
 static bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint160, int> > &addresses)
 {
     if (params[0].isStr()) {
-        CTxDestination dest = DecodeDestination(params[0].get_str());
-        CScript scriptPubKey = GetScriptForDestination(dest);
-        uint160 hashBytes;
-        int addressType = 0;
-
-        if (scriptPubKey.IsPayToScriptHash()) {
-            hashBytes = uint160(std::vector <unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.begin() + 22));
-            addressType = 2;
-        } else if (scriptPubKey.IsPayToPublicKeyHash()) {
-            hashBytes = uint160(std::vector <unsigned char>(scriptPubKey.begin() + 3, scriptPubKey.begin() + 23));
-            addressType = 1;
-        } else if (scriptPubKey.IsPayToWitnessPubkeyHash()) {
-            hashBytes = uint160(std::vector <unsigned char>(scriptPubKey.begin() + 2, scriptPubKey.end()));
-            addressType = 1;
-        } else if (scriptPubKey.IsPayToWitnessScriptHash()) {
-            hashBytes = Hash160(std::vector <unsigned char> (scriptPubKey.begin() + 2, scriptPubKey.end()));
-            addressType = 2;
-        } else {
-            hashBytes.SetNull();
-            addressType = 0;
+        getAddressFromString(params[0].get_str(), addresses);
+    } else if (params[0].isObject()) {
+        UniValue addressValues = find_value(params[0].get_obj(), "addresses");
+        if (!addressValues.isArray()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Addresses is expected to be an array");
         }
-
-        if (addressType == 0) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+        for (const UniValue& address : addressValues.getValues()) {
+            getAddressFromString(address.get_str(), addresses);
         }
-
-        addresses.push_back(std::make_pair(hashBytes, addressType));
     } else {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
@@ -291,6 +304,71 @@ static bool getAddressesFromParams(const UniValue& params, std::vector<std::pair
     return true;
 }
 
+/** Largest page the address index RPCs return for one request */
+static const int MAX_ADDRESS_PAGE_SIZE = 10000;
+
+/** Read the optional "limit" and "cursor" members of the request object */
+static void getPagingFromParams(const UniValue& params, int& limit, std::string& cursor)
+{
+    limit = 0;
+    cursor.clear();
+    if (!params[0].isObject()) {
+        return;
+    }
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (!limitValue.isNull()) {
+        limit = limitValue.get_int();
+        if (limit <= 0 || limit > MAX_ADDRESS_PAGE_SIZE) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Limit is expected to be between 1 and %d", MAX_ADDRESS_PAGE_SIZE));
+        }
+    }
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (!cursorValue.isNull()) {
+        if (limit == 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor requires a limit");
+        }
+        cursor = cursorValue.get_str();
+    }
+}
+
+/** Continuation tokens are the hex encoded index key of the last entry returned */
+template <typename Key>
+static std::string EncodeAddressCursor(const Key& key)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << key;
+    return HexStr(ssKey.begin(), ssKey.end());
+}
+
+/** Decode a continuation token and find which of the requested addresses it resumes */
+template <typename Key>
+static Key DecodeAddressCursor(const std::string& cursor, const std::vector<std::pair<uint160, int> > &addresses, size_t& nAddress)
+{
+    if (!IsHex(cursor)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    std::vector<unsigned char> data(ParseHex(cursor));
+    CDataStream ssKey(data, SER_DISK, CLIENT_VERSION);
+    Key key;
+    try {
+        ssKey >> key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!ssKey.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+
+    for (nAddress = 0; nAddress < addresses.size(); nAddress++) {
+        if (addresses[nAddress].first == key.hashBytes && addresses[nAddress].second == (int)key.type) {
+            return key;
+        }
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not match the requested addresses");
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -329,8 +407,11 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
             "  \"chainInfo\" (boolean) Include chain info in results, only applies if start and end specified\n"
+            "  \"limit\" (number, optional) Return at most this many deltas, up to " + std::to_string(MAX_ADDRESS_PAGE_SIZE) + "\n"
+            "  \"cursor\" (string, optional) Continue after the last page, as returned in \"cursor\"\n"
             "}\n"
-            "\nResult:\n"
+            "\nResult (when limit or chainInfo is given the deltas are returned in a \"deltas\" object member,\n"
+            "next to \"cursor\", which is only present if there are more results):\n"
             "[\n"
             "  {\n"
             "    \"satoshis\"  (number) The difference of satoshis\n"
@@ -375,36 +456,48 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    int limit;
+    std::string cursor;
+    getPagingFromParams(request.params, limit, cursor);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    size_t nFirstAddress = 0;
+    CAddressIndexKey after;
+    if (!cursor.empty()) {
+        after = DecodeAddressCursor<CAddressIndexKey>(cursor, addresses, nFirstAddress);
     }
 
     UniValue deltas(UniValue::VARR);
+    CAddressIndexKey last;
+    bool fMore = false;
+
+    auto push_delta = [&](const CAddressIndexKey& key, CAmount value) {
+        if (limit > 0 && deltas.size() == (size_t)limit) {
+            fMore = true;
+            return false;
+        }
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
         UniValue delta(UniValue::VOBJ);
-        delta.pushKV("satoshis", it->second);
-        delta.pushKV("txid", it->first.txhash.GetHex());
-        delta.pushKV("index", (int)it->first.index);
-        delta.pushKV("blockindex", (int)it->first.txindex);
-        delta.pushKV("height", it->first.blockHeight);
+        delta.pushKV("satoshis", value);
+        delta.pushKV("txid", key.txhash.GetHex());
+        delta.pushKV("index", (int)key.index);
+        delta.pushKV("blockindex", (int)key.txindex);
+        delta.pushKV("height", key.blockHeight);
         delta.pushKV("address", address);
         deltas.push_back(delta);
+        last = key;
+        return true;
+    };
+
+    for (size_t i = nFirstAddress; i < addresses.size() && !fMore; i++) {
+        const CAddressIndexKey* pAfter = (!cursor.empty() && i == nFirstAddress) ? &after : nullptr;
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, pAfter, start, end, push_delta)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
     }
 
     UniValue result(UniValue::VOBJ);
@@ -431,11 +524,16 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         result.pushKV("deltas", deltas);
         result.pushKV("start", startInfo);
         result.pushKV("end", endInfo);
-
-        return result;
+    } else if (limit > 0) {
+        result.pushKV("deltas", deltas);
     } else {
         return deltas;
     }
+
+    if (fMore) {
+        result.pushKV("cursor", EncodeAddressCursor(last));
+    }
+    return result;
 }
 
 UniValue getaddressbalance(const JSONRPCRequest& request)
@@ -468,22 +566,16 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressSummaryValue summary;
+        if (!GetAddressSummary((*it).first, (*it).second, summary)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += summary.balance;
+        received += summary.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -507,8 +599,11 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "      ,...\n"
             "    ],\n"
             "  \"chainInfo\"  (boolean) Include chain info with results\n"
+            "  \"limit\" (number, optional) Return at most this many outputs, up to " + std::to_string(MAX_ADDRESS_PAGE_SIZE) + "\n"
+            "  \"cursor\" (string, optional) Continue after the last page, as returned in \"cursor\"\n"
             "}\n"
-            "\nResult\n"
+            "\nResult (when limit is given, outputs are ordered by txid instead of height and returned in a \"utxos\"\n"
+            "object member, next to \"cursor\", which is only present if there are more results)\n"
             "[\n"
             "  {\n"
             "    \"address\"  (string) The address base58check encoded\n"
@@ -540,48 +635,87 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    int limit;
+    std::string cursor;
+    getPagingFromParams(request.params, limit, cursor);
 
     UniValue utxos(UniValue::VARR);
     CAmount total = 0;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
+    CAddressUnspentKey last;
+    bool fMore = false;
+
+    auto push_utxo = [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
         if (requiredAmount > 0 && total >= requiredAmount) {
-            break;
+            return false;
+        }
+        if (limit > 0 && utxos.size() == (size_t)limit) {
+            fMore = true;
+            return false;
         }
 
         UniValue output(UniValue::VOBJ);
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
         output.pushKV("address", address);
-        output.pushKV("txid", it->first.txhash.GetHex());
-        output.pushKV("outputIndex", (int)it->first.index);
-        output.pushKV("script", HexStr(it->second.script.begin(), it->second.script.end()));
-        output.pushKV("satoshis", it->second.satoshis);
-        output.pushKV("height", it->second.blockHeight);
+        output.pushKV("txid", key.txhash.GetHex());
+        output.pushKV("outputIndex", (int)key.index);
+        output.pushKV("script", HexStr(value.script.begin(), value.script.end()));
+        output.pushKV("satoshis", value.satoshis);
+        output.pushKV("height", value.blockHeight);
 
         utxos.push_back(output);
+        last = key;
+
+        total += value.satoshis;
+        return true;
+    };
+
+    if (limit > 0) {
+        // Pages are streamed straight from the index in key order
+        size_t nFirstAddress = 0;
+        CAddressUnspentKey after;
+        if (!cursor.empty()) {
+            after = DecodeAddressCursor<CAddressUnspentKey>(cursor, addresses, nFirstAddress);
+        }
+        for (size_t i = nFirstAddress; i < addresses.size() && !fMore; i++) {
+            const CAddressUnspentKey* pAfter = (!cursor.empty() && i == nFirstAddress) ? &after : nullptr;
+            if (!GetAddressUnspent(addresses[i].first, addresses[i].second, pAfter, push_utxo)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+    } else {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
+
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
 
-        total += it->second.satoshis;
+        for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
+            if (!push_utxo(it->first, it->second)) {
+                break;
+            }
+        }
     }
 
-    if (includeChainInfo) {
+    if (includeChainInfo || limit > 0) {
         UniValue result(UniValue::VOBJ);
         result.pushKV("utxos", utxos);
+        if (fMore) {
+            result.pushKV("cursor", EncodeAddressCursor(last));
+        }
 
-        LOCK(cs_main);
-        result.pushKV("hash", chainActive.Tip()->GetBlockHash().GetHex());
-        result.pushKV("height", (int)chainActive.Height());
+        if (includeChainInfo) {
+            LOCK(cs_main);
+            result.pushKV("hash", chainActive.Tip()->GetBlockHash().GetHex());
+            result.pushKV("height", (int)chainActive.Height());
+        }
         return result;
     } else {
         return utxos;
@@ -794,8 +928,11 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many txids, up to " + std::to_string(MAX_ADDRESS_PAGE_SIZE) + "\n"
+            "  \"cursor\" (string, optional) Continue after the last page, as returned in \"cursor\"\n"
             "}\n"
-            "\nResult:\n"
+            "\nResult (when limit is given, txids are listed per address and returned in a \"txids\" object member,\n"
+            "next to \"cursor\", which is only present if there are more results):\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
@@ -822,26 +959,40 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
     //     }
     // }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    int limit;
+    std::string cursor;
+    getPagingFromParams(request.params, limit, cursor);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    size_t nFirstAddress = 0;
+    CAddressIndexKey after;
+    if (!cursor.empty()) {
+        after = DecodeAddressCursor<CAddressIndexKey>(cursor, addresses, nFirstAddress);
     }
 
     std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
+    CAddressIndexKey last;
+    uint256 lastTxid;
+    bool fMore = false;
+
+    auto push_txid = [&](const CAddressIndexKey& key, CAmount value) {
+        if (limit > 0) {
+            // The entries of one transaction are adjacent, so a page never
+            // ends in the middle of a transaction
+            if (key.txhash != lastTxid) {
+                if (result.size() == (size_t)limit) {
+                    fMore = true;
+                    return false;
+                }
+                result.push_back(key.txhash.GetHex());
+                lastTxid = key.txhash;
+            }
+            last = key;
+            return true;
+        }
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
+        int height = key.blockHeight;
+        std::string txid = key.txhash.GetHex();
 
         if (addresses.size() > 1) {
             txids.insert(std::make_pair(height, txid));
@@ -850,6 +1001,23 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                 result.push_back(txid);
             }
         }
+        return true;
+    };
+
+    for (size_t i = nFirstAddress; i < addresses.size() && !fMore; i++) {
+        const CAddressIndexKey* pAfter = (!cursor.empty() && i == nFirstAddress) ? &after : nullptr;
+        if (!GetAddressIndex(addresses[i].first, addresses[i].second, pAfter, start, end, push_txid)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    if (limit > 0) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("txids", result);
+        if (fMore) {
+            page.pushKV("cursor", EncodeAddressCursor(last));
+        }
+        return page;
     }
 
     if (addresses.size() > 1) {
@@ -1034,6 +1034,129 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
     return hashTx.GetHex();
 }
 
+/** Maximum number of transactions sendrawtransactions accepts in one call */
+static const unsigned int MAX_SEND_RAW_TRANSACTIONS = 1000;
+
+UniValue sendrawtransactions(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "sendrawtransactions [\"hexstring\",...] ( allowhighfees )\n"
+            "\nSubmits a batch of raw transactions (serialized, hex-encoded) to local node and network.\n"
+            "The transactions are accepted to the mempool under a single lock, and may spend outputs\n"
+            "of each other in any order. Unlike sendrawtransaction, a rejected transaction does not\n"
+            "raise an error; its reason is reported in the result instead.\n"
+            "\nArguments:\n"
+            "1. \"hexstrings\"   (array, required) The hex strings of the raw transactions, at most " + std::to_string(MAX_SEND_RAW_TRANSACTIONS) + "\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "[                   (array) One entry per transaction, in the order given\n"
+            "  {\n"
+            "    \"txid\" : \"hex\",   (string) The transaction hash in hex\n"
+            "    \"accepted\" : true|false, (boolean) Whether the transaction is now in the mempool\n"
+            "    \"error\" : \"reason\" (string, optional) Why the transaction was rejected\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendrawtransactions", "\"[\\\"signedhex\\\",\\\"signedhex\\\"]\"") +
+            "\nAs a json rpc call\n"
+            + HelpExampleRpc("sendrawtransactions", "[\"signedhex\",\"signedhex\"]")
+        );
+
+    ObserveSafeMode();
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+
+    const UniValue& hexstrings = request.params[0].get_array();
+    if (hexstrings.size() > MAX_SEND_RAW_TRANSACTIONS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("At most %u transactions can be sent at once", MAX_SEND_RAW_TRANSACTIONS));
+    std::vector<CTransactionRef> vtx;
+    vtx.reserve(hexstrings.size());
+    for (size_t i = 0; i < hexstrings.size(); i++) {
+        CMutableTransaction mtx;
+        if (!hexstrings[i].isStr() || !DecodeHexTx(mtx, hexstrings[i].get_str()))
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %u", i));
+        vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    CAmount nMaxRawTxFee = maxTxFee;
+    if (!request.params[1].isNull() && request.params[1].get_bool())
+        nMaxRawTxFee = 0;
+
+    std::vector<std::string> vError(vtx.size());
+    std::vector<bool> vRelay(vtx.size(), false);
+    std::promise<void> promise;
+
+    { // cs_main scope
+    LOCK(cs_main);
+    CCoinsViewCache &view = *pcoinsTip;
+    std::vector<CTransactionRef> vtxSubmit;
+    std::vector<size_t> vSubmitIndex;
+    for (size_t i = 0; i < vtx.size(); i++) {
+        const uint256& hashTx = vtx[i]->GetHash();
+        bool fHaveChain = false;
+        for (size_t o = 0; !fHaveChain && o < vtx[i]->vout.size(); o++) {
+            fHaveChain = !view.AccessCoin(COutPoint(hashTx, o)).IsSpent();
+        }
+        if (fHaveChain) {
+            vError[i] = "transaction already in block chain";
+        } else if (mempool.exists(hashTx)) {
+            vRelay[i] = true;
+        } else {
+            vtxSubmit.push_back(vtx[i]);
+            vSubmitIndex.push_back(i);
+        }
+    }
+
+    std::vector<CValidationState> vState;
+    std::vector<bool> vMissingInputs;
+    AcceptToMemoryPoolBatch(mempool, vtxSubmit, vState, vMissingInputs, nullptr /* plTxnReplaced */, nMaxRawTxFee);
+    for (size_t j = 0; j < vtxSubmit.size(); j++) {
+        const size_t i = vSubmitIndex[j];
+        if (mempool.exists(vtxSubmit[j]->GetHash())) {
+            vRelay[i] = true;
+        } else if (vState[j].IsInvalid()) {
+            vError[i] = strprintf("%i: %s", vState[j].GetRejectCode(), vState[j].GetRejectReason());
+        } else if (vMissingInputs[j]) {
+            vError[i] = "Missing inputs";
+        } else {
+            vError[i] = vState[j].GetRejectReason();
+        }
+    }
+
+    // Make sure the wallet has seen the new transactions before returning,
+    // as sendrawtransaction does
+    CallFunctionInValidationInterfaceQueue([&promise] {
+        promise.set_value();
+    });
+    } // cs_main
+
+    promise.get_future().wait();
+
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", vtx[i]->GetHash().GetHex());
+        entry.pushKV("accepted", UniValue((bool)vRelay[i]));
+        if (vRelay[i]) {
+            CInv inv(MSG_TX, vtx[i]->GetHash());
+            g_connman->ForEachNode([&inv](CNode* pnode)
+            {
+                pnode->PushInventory(inv);
+            });
+        } else {
+            entry.pushKV("error", vError[i]);
+        }
+        result.push_back(entry);
+    }
+
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1042,6 +1165,7 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   {"hexstring","iswitness"} },
     { "rawtransactions",    "decodescript",           &decodescript,           {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "sendrawtransactions",    &sendrawtransactions,    {"hexstrings","allowhighfees"} },
     { "rawtransactions",    "combinerawtransaction",  &combinerawtransaction,  {"txs"} },
     { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
 
@@ -5,18 +5,105 @@
 
 #include "stats/stats.h"
 
-#include "memusage.h"
+#include "net.h"
+#include "net_processing.h"
+#include "policy/policy.h"
+#include "txmempool.h"
+#include "util.h"
 #include "utiltime.h"
+#include "validation.h"
 
-#include "util.h"
+#include <algorithm>
+#include <limits>
 
-static const uint32_t SAMPLE_MIN_DELTA_IN_SEC = 2;
-static const int CLEANUP_SAMPLES_THRESHOLD = 100;
-static const size_t MAX_MEMORY_STATS = 10 * 1024 * 1024; //10 MB
 std::atomic<bool> CStats::m_stats_enabled(false); //disable stats by default
 
 CStats* CStats::m_shared_instance = NULL;
 
+CStatsTier::CStatsTier(uint32_t intervalIn, size_t capacityIn) :
+    m_interval(intervalIn), m_ring(capacityIn), m_next(0), m_count(0), m_acc(), m_acc_samples(0)
+{
+}
+
+CStatsMempoolSample CStatsTier::Current() const
+{
+    CStatsMempoolSample sample = m_acc;
+    sample.m_tx_count /= m_acc_samples;
+    sample.m_dyn_mem_usage /= m_acc_samples;
+    sample.m_min_fee_per_k /= m_acc_samples;
+    sample.m_orphan_count /= m_acc_samples;
+    for (int64_t& vsize : sample.m_feerate_vsize)
+        vsize /= m_acc_samples;
+    return sample;
+}
+
+void CStatsTier::Add(const CStatsMempoolSample& sample)
+{
+    uint32_t start = sample.m_time_delta - sample.m_time_delta % m_interval;
+    if (m_acc_samples > 0 && start != m_acc.m_time_delta) {
+        // the interval of the accumulated samples is over
+        m_ring[m_next] = Current();
+        m_next = (m_next + 1) % m_ring.size();
+        m_count = std::min(m_count + 1, m_ring.size());
+        m_acc_samples = 0;
+    }
+
+    if (m_acc_samples == 0) {
+        m_acc = sample;
+        m_acc.m_time_delta = start;
+    } else {
+        m_acc.m_tx_count += sample.m_tx_count;
+        m_acc.m_dyn_mem_usage += sample.m_dyn_mem_usage;
+        m_acc.m_min_fee_per_k += sample.m_min_fee_per_k;
+        m_acc.m_orphan_count += sample.m_orphan_count;
+        m_acc.m_tx_accepted += sample.m_tx_accepted;
+        m_acc.m_bytes_recv += sample.m_bytes_recv;
+        m_acc.m_bytes_sent += sample.m_bytes_sent;
+        for (int i = 0; i < STATS_FEERATE_BUCKETS; i++)
+            m_acc.m_feerate_vsize[i] += sample.m_feerate_vsize[i];
+    }
+    m_acc_samples++;
+}
+
+mempoolSamples_t CStatsTier::GetRange(uint32_t fromDelta, uint32_t toDelta) const
+{
+    // a sample is returned if any part of its interval is in range
+    auto in_range = [&](const CStatsMempoolSample& sample) {
+        return sample.m_time_delta <= toDelta && (uint64_t)sample.m_time_delta + m_interval > fromDelta;
+    };
+
+    mempoolSamples_t samples;
+    for (size_t i = 0; i < m_count; i++) {
+        const CStatsMempoolSample& sample = m_ring[(m_next + m_ring.size() - m_count + i) % m_ring.size()];
+        if (in_range(sample))
+            samples.push_back(sample);
+    }
+    if (m_acc_samples > 0 && in_range(m_acc))
+        samples.push_back(Current());
+    return samples;
+}
+
+bool CStatsTier::GetOldest(uint32_t& delta) const
+{
+    if (m_count > 0) {
+        delta = m_ring[(m_next + m_ring.size() - m_count) % m_ring.size()].m_time_delta;
+        return true;
+    }
+    if (m_acc_samples > 0) {
+        delta = m_acc.m_time_delta;
+        return true;
+    }
+    return false;
+}
+
+CStats::CStats() :
+    m_start_time(0), m_tx_accepted(0), m_last_bytes_recv(0), m_last_bytes_sent(0)
+{
+    // all memory is allocated up front
+    for (int i = 0; i < STATS_TIERS; i++)
+        m_tiers.emplace_back(STATS_TIER_INTERVALS[i], STATS_TIER_SAMPLES[i]);
+}
+
 CStats* CStats::DefaultStats()
 {
     if (!m_shared_instance)
@@ -25,7 +112,42 @@ CStats* CStats::DefaultStats()
     return m_shared_instance;
 }
 
-void CStats::addMempoolSample(int64_t txcount, int64_t dynUsage, int64_t currentMinRelayFee)
+void CStats::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    m_tx_accepted++;
+}
+
+void CStats::CollectSample()
+{
+    if (!m_stats_enabled)
+        return;
+
+    CStatsMempoolSample sample{};
+    {
+        LOCK(mempool.cs);
+        sample.m_tx_count = mempool.size();
+        sample.m_dyn_mem_usage = mempool.DynamicMemoryUsage();
+        sample.m_min_fee_per_k = mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK();
+    }
+    FeeHistogram feeHistogram, ancestorFeeHistogram;
+    mempool.GetFeeHistograms(feeHistogram, ancestorFeeHistogram);
+    for (int i = 0; i < STATS_FEERATE_BUCKETS; i++)
+        sample.m_feerate_vsize[i] = feeHistogram[i].nSize;
+    sample.m_orphan_count = GetOrphanTxCount();
+    sample.m_tx_accepted = m_tx_accepted.exchange(0);
+    if (g_connman) {
+        uint64_t bytesRecv = g_connman->GetTotalBytesRecv();
+        uint64_t bytesSent = g_connman->GetTotalBytesSent();
+        LOCK(cs_stats);
+        sample.m_bytes_recv = bytesRecv - m_last_bytes_recv;
+        sample.m_bytes_sent = bytesSent - m_last_bytes_sent;
+        m_last_bytes_recv = bytesRecv;
+        m_last_bytes_sent = bytesSent;
+    }
+    addMempoolSample(sample);
+}
+
+void CStats::addMempoolSample(CStatsMempoolSample sample)
 {
     if (!m_stats_enabled)
         return;
@@ -35,41 +157,16 @@ void CStats::addMempoolSample(int64_t txcount, int64_t dynUsage, int64_t current
         LOCK(cs_stats);
 
         // set the mempool stats start time if this is the first sample
-        if (m_mempool_stats.m_start_time == 0)
-            m_mempool_stats.m_start_time = now;
-
-        // ensure the minimum time delta between samples
-        if (m_mempool_stats.m_samples.size() && m_mempool_stats.m_samples.back().m_time_delta + SAMPLE_MIN_DELTA_IN_SEC >= now - m_mempool_stats.m_start_time)
-            return;
-
-        // calculate the current time delta and add a sample
-        uint32_t timeDelta = now - m_mempool_stats.m_start_time; //truncate to uint32_t should be sufficient
-        m_mempool_stats.m_samples.push_back({timeDelta, txcount, dynUsage, currentMinRelayFee});
-        m_mempool_stats.m_cleanup_counter++;
-
-        // check if we should cleanup the container
-        if (m_mempool_stats.m_cleanup_counter >= CLEANUP_SAMPLES_THRESHOLD) {
-            //check memory usage
-            int32_t memDelta = memusage::DynamicUsage(m_mempool_stats.m_samples) - MAX_MEMORY_STATS;
-            if (memDelta > 0 && m_mempool_stats.m_samples.size()) {
-                // only shrink if the vector.capacity() is > the target for performance reasons
-                m_mempool_stats.m_samples.shrink_to_fit();
-                int32_t memUsage = memusage::DynamicUsage(m_mempool_stats.m_samples);
-                // calculate the amount of samples we need to remove
-                size_t itemsToRemove = ceil((memUsage - MAX_MEMORY_STATS) / sizeof(m_mempool_stats.m_samples[0]));
-
-                // make sure the vector contains more items then we'd like to remove
-                if (m_mempool_stats.m_samples.size() > itemsToRemove)
-                    m_mempool_stats.m_samples.erase(m_mempool_stats.m_samples.begin(), m_mempool_stats.m_samples.begin() + itemsToRemove);
-            }
-            // shrink vector
-            m_mempool_stats.m_samples.shrink_to_fit();
-            m_mempool_stats.m_cleanup_counter = 0;
-        }
+        if (m_start_time == 0)
+            m_start_time = now;
 
-        // fire signal
-        MempoolStatsDidChange();
+        sample.m_time_delta = now - m_start_time; //truncate to uint32_t should be sufficient
+        for (CStatsTier& tier : m_tiers)
+            tier.Add(sample);
     }
+
+    // fire signal
+    MempoolStatsDidChange();
 }
 
 mempoolSamples_t CStats::mempoolGetValuesInRange(uint64_t& fromTime, uint64_t& toTime)
@@ -77,42 +174,60 @@ mempoolSamples_t CStats::mempoolGetValuesInRange(uint64_t& fromTime, uint64_t& t
     if (!m_stats_enabled)
         return mempoolSamples_t();
 
-    LOCK(cs_stats);
-
-    // if empty, return directly
-    if (!m_mempool_stats.m_samples.size())
-        return m_mempool_stats.m_samples;
-
-
-    if (!(fromTime == 0 && toTime == 0) && (fromTime > m_mempool_stats.m_start_time + m_mempool_stats.m_samples.front().m_time_delta || toTime < m_mempool_stats.m_start_time + m_mempool_stats.m_samples.back().m_time_delta)) {
-        mempoolSamples_t::iterator fromSample = m_mempool_stats.m_samples.begin();
-        mempoolSamples_t::iterator toSample = std::prev(m_mempool_stats.m_samples.end());
-
-        // create subset of samples
-        bool fromSet = false;
-        for (mempoolSamples_t::iterator it = m_mempool_stats.m_samples.begin(); it != m_mempool_stats.m_samples.end(); ++it) {
-            if (m_mempool_stats.m_start_time + (*it).m_time_delta >= fromTime && !fromSet) {
-                fromSample = it;
-                fromSet = true;
-            }
-            else if (m_mempool_stats.m_start_time + (*it).m_time_delta > toTime) {
-                toSample = std::prev(it);
+    uint32_t interval = m_tiers.back().Interval();
+    {
+        LOCK(cs_stats);
+        // use the finest tier that still has samples from fromTime
+        for (const CStatsTier& tier : m_tiers) {
+            uint32_t oldest;
+            if (tier.GetOldest(oldest) && m_start_time + oldest <= fromTime) {
+                interval = tier.Interval();
                 break;
             }
         }
+        if (fromTime == 0 && toTime == 0)
+            interval = m_tiers.front().Interval();
+    }
 
-        mempoolSamples_t subset(fromSample, toSample + 1);
+    mempoolSamples_t samples;
+    mempoolGetValuesInRange(interval, fromTime, toTime, samples);
+    return samples;
+}
 
-        // set the fromTime and toTime pass-by-ref parameters
-        fromTime = m_mempool_stats.m_start_time + (*fromSample).m_time_delta;
-        toTime = m_mempool_stats.m_start_time + (*toSample).m_time_delta;
+bool CStats::mempoolGetValuesInRange(uint32_t interval, uint64_t& fromTime, uint64_t& toTime, mempoolSamples_t& samples)
+{
+    samples.clear();
+    if (!m_stats_enabled)
+        return false;
 
-        // return subset
-        return subset;
+    LOCK(cs_stats);
+    auto tier = std::find_if(m_tiers.begin(), m_tiers.end(), [interval](const CStatsTier& t) { return t.Interval() == interval; });
+    if (tier == m_tiers.end())
+        return false;
+    if (m_start_time == 0)
+        return true;
+
+    // a range of 0 to 0 asks for all samples
+    uint32_t fromDelta = 0;
+    uint32_t toDelta = std::numeric_limits<uint32_t>::max();
+    if (fromTime != 0 || toTime != 0) {
+        fromDelta = std::min<uint64_t>(fromTime > m_start_time ? fromTime - m_start_time : 0, toDelta);
+        toDelta = std::min<uint64_t>(toTime > m_start_time ? toTime - m_start_time : 0, toDelta);
+        if (toTime < m_start_time)
+            return true;
     }
 
-    // return all available samples
-    fromTime = m_mempool_stats.m_start_time + m_mempool_stats.m_samples.front().m_time_delta;
-    toTime = m_mempool_stats.m_start_time + m_mempool_stats.m_samples.back().m_time_delta;
-    return m_mempool_stats.m_samples;
-}
\ No newline at end of file
+    samples = tier->GetRange(fromDelta, toDelta);
+    if (!samples.empty()) {
+        // set the fromTime and toTime pass-by-ref parameters
+        fromTime = m_start_time + samples.front().m_time_delta;
+        toTime = m_start_time + samples.back().m_time_delta;
+    }
+    return true;
+}
+
+uint64_t CStats::mempoolStartTime() const
+{
+    LOCK(cs_stats);
+    return m_start_time;
+}
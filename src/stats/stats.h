@@ -6,59 +6,120 @@
 #ifndef BITCOIN_STATS_H
 #define BITCOIN_STATS_H
 
+#include <amount.h>
 #include <sync.h>
+#include <txmempool.h>
+#include <validationinterface.h>
 
+#include <array>
 #include <atomic>
 #include <stdlib.h>
 #include <vector>
 
 #include <boost/signals2/signal.hpp>
 
+static const bool DEFAULT_MEMPOOL_STATS = false;
+/** Seconds between two samples of the finest tier */
+static const int64_t STATS_SAMPLE_INTERVAL = 1;
+
+/** Number of buckets of the mempool feerate histogram series, bounded by FEE_HISTOGRAM_LIMITS */
+static const int STATS_FEERATE_BUCKETS = FEE_HISTOGRAM_BUCKETS;
+
+/** Number of downsampling tiers */
+static const int STATS_TIERS = 3;
+/** Seconds covered by one sample of each tier */
+static const uint32_t STATS_TIER_INTERVALS[STATS_TIERS] = {1, 60, 60 * 60};
+/** Number of samples each tier keeps: an hour, a day and a month */
+static const size_t STATS_TIER_SAMPLES[STATS_TIERS] = {60 * 60, 24 * 60, 30 * 24};
+
 struct CStatsMempoolSample {
     uint32_t m_time_delta;    //use 32bit time delta to save memory
     int64_t m_tx_count;       //transaction count
     int64_t m_dyn_mem_usage;  //dynamic mempool usage
     int64_t m_min_fee_per_k;  //min fee per Kb
+    int64_t m_orphan_count;   //orphan pool size
+    uint32_t m_tx_accepted;   //transactions accepted to the mempool during the sample
+    uint64_t m_bytes_recv;    //bytes received from peers during the sample
+    uint64_t m_bytes_sent;    //bytes sent to peers during the sample
+    std::array<int64_t, STATS_FEERATE_BUCKETS> m_feerate_vsize; //virtual size of mempool transactions per feerate bucket
 };
 
 typedef std::vector<struct CStatsMempoolSample> mempoolSamples_t;
 
-// simple mempool stats container
-class CStatsMempool
+/**
+ * Fixed size ring buffer of samples at one resolution. Incoming samples are
+ * accumulated until their interval is over: gauges are averaged, counters
+ * are summed.
+ */
+class CStatsTier
 {
 public:
-    uint64_t m_start_time;      //start time of the container
-    mempoolSamples_t m_samples;
-    uint64_t m_cleanup_counter; //internal counter to trogger cleanups
-
-    CStatsMempool()
-    {
-        m_start_time = 0;
-        m_cleanup_counter = 0;
-    }
+    CStatsTier(uint32_t intervalIn, size_t capacityIn);
+
+    uint32_t Interval() const { return m_interval; }
+
+    /** Add a sample taken at start_time + sample.m_time_delta */
+    void Add(const CStatsMempoolSample& sample);
+    /** Samples between the two time deltas, including the one still being accumulated */
+    mempoolSamples_t GetRange(uint32_t fromDelta, uint32_t toDelta) const;
+    /** Time delta of the oldest sample kept, or false if there are none */
+    bool GetOldest(uint32_t& delta) const;
+
+private:
+    uint32_t m_interval;
+    mempoolSamples_t m_ring;
+    size_t m_next;
+    size_t m_count;
+
+    //! Sums of the samples of the current interval
+    CStatsMempoolSample m_acc;
+    uint32_t m_acc_samples;
+
+    CStatsMempoolSample Current() const;
 };
 
 // Class that manages various types of statistics and its memory consumption
-class CStats
+class CStats : public CValidationInterface
 {
 private:
     static CStats* m_shared_instance;
     mutable CCriticalSection cs_stats;
 
-    CStatsMempool m_mempool_stats; //mempool stats container
+    uint64_t m_start_time; //time of the first sample, all samples store the time relative to it
+    std::vector<CStatsTier> m_tiers;
+
+    //! Transactions accepted since the previous CollectSample
+    std::atomic<uint32_t> m_tx_accepted;
+    //! Traffic counters at the previous CollectSample
+    uint64_t m_last_bytes_recv;
+    uint64_t m_last_bytes_sent;
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override;
 
 public:
+    CStats();
+
     static std::atomic<bool> m_stats_enabled; //if enabled, stats will be collected
     static CStats* DefaultStats(); //shared instance
 
     /* signals */
     boost::signals2::signal<void(void)> MempoolStatsDidChange; //mempool stats update signal
 
-    /* add a mempool stats sample */
-    void addMempoolSample(int64_t txcount, int64_t dynUsage, int64_t currentMinRelayFee);
+    /* take a sample of the mempool, the orphan pool and the network traffic, called every STATS_SAMPLE_INTERVAL */
+    void CollectSample();
 
-    /* get all mempool samples in range */
+    /* add a mempool stats sample taken now, m_time_delta is filled in */
+    void addMempoolSample(CStatsMempoolSample sample);
+
+    /* get mempool samples in range from the finest tier that reaches back to fromTime */
     mempoolSamples_t mempoolGetValuesInRange(uint64_t& fromTime, uint64_t& toTime);
+
+    /* time of the first sample, the samples' m_time_delta is relative to it */
+    uint64_t mempoolStartTime() const;
+
+    /* get mempool samples of the tier with the given interval, false if there is no such tier */
+    bool mempoolGetValuesInRange(uint32_t interval, uint64_t& fromTime, uint64_t& toTime, mempoolSamples_t& samples);
 };
 
-#endif // BITCOIN_STATS_H
\ No newline at end of file
+#endif // BITCOIN_STATS_H
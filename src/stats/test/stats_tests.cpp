@@ -0,0 +1,100 @@
+// Copyright (c) 2020 Beyondtoshi
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "stats/stats.h"
+
+#include "test/test_bitcoin.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(stats_tests, BasicTestingSetup)
+
+static CStatsMempoolSample MakeSample(int64_t txcount, uint32_t accepted)
+{
+    CStatsMempoolSample sample{};
+    sample.m_tx_count = txcount;
+    sample.m_dyn_mem_usage = txcount * 1000;
+    sample.m_tx_accepted = accepted;
+    sample.m_feerate_vsize[1] = txcount * 200;
+    return sample;
+}
+
+BOOST_AUTO_TEST_CASE(stats)
+{
+    CStats::m_stats_enabled = true;
+    CStats stats;
+
+    uint64_t start = GetTime();
+    SetMockTime(start);
+    stats.addMempoolSample(MakeSample(1, 1));
+    SetMockTime(start + 1);
+    stats.addMempoolSample(MakeSample(2, 1));
+    stats.addMempoolSample(MakeSample(4, 2)); // same second, averaged with the previous one
+    SetMockTime(start + 5);
+    stats.addMempoolSample(MakeSample(3, 0));
+    BOOST_CHECK_EQUAL(stats.mempoolStartTime(), start);
+
+    uint64_t queryFromTime = 0;
+    uint64_t queryToTime = 0;
+    mempoolSamples_t samples;
+    BOOST_CHECK(stats.mempoolGetValuesInRange(1, queryFromTime, queryToTime, samples));
+    BOOST_CHECK_EQUAL(samples.size(), 3U);
+    BOOST_CHECK_EQUAL(samples[0].m_time_delta, 0U);
+    BOOST_CHECK_EQUAL(samples[1].m_time_delta, 1U);
+    BOOST_CHECK_EQUAL(samples[1].m_tx_count, 3);
+    BOOST_CHECK_EQUAL(samples[1].m_dyn_mem_usage, 3000);
+    BOOST_CHECK_EQUAL(samples[1].m_tx_accepted, 3U);
+    BOOST_CHECK_EQUAL(samples[1].m_feerate_vsize[1], 600);
+    BOOST_CHECK_EQUAL(samples[2].m_time_delta, 5U);
+    BOOST_CHECK_EQUAL(queryFromTime, start);
+    BOOST_CHECK_EQUAL(queryToTime, start + 5);
+
+    // the minute tier has a single sample covering all four
+    BOOST_CHECK(stats.mempoolGetValuesInRange(60, queryFromTime, queryToTime, samples));
+    BOOST_CHECK_EQUAL(samples.size(), 1U);
+    BOOST_CHECK_EQUAL(samples[0].m_tx_count, (1 + 2 + 4 + 3) / 4);
+    BOOST_CHECK_EQUAL(samples[0].m_tx_accepted, 4U);
+
+    // there is no tier with that resolution
+    BOOST_CHECK(!stats.mempoolGetValuesInRange(2, queryFromTime, queryToTime, samples));
+
+    // check retriving a subset of the available samples
+    queryFromTime = start;
+    queryToTime = start;
+    samples = stats.mempoolGetValuesInRange(queryFromTime, queryToTime);
+    BOOST_CHECK_EQUAL(samples.size(), 1U);
+
+    // fill the finest tier beyond its capacity
+    for (int i = 0; i < 7200; i++) {
+        SetMockTime(start + 10 + i);
+        stats.addMempoolSample(MakeSample(i, 1));
+    }
+
+    queryFromTime = start + 3600 * 2;
+    queryToTime = start + 3600 * 2;
+    samples = stats.mempoolGetValuesInRange(queryFromTime, queryToTime);
+    BOOST_CHECK_EQUAL(samples.size(), 1U); //get a single sample
+    BOOST_CHECK_EQUAL(queryFromTime, start + 3600 * 2);
+
+    queryFromTime = 0;
+    queryToTime = 0;
+    BOOST_CHECK(stats.mempoolGetValuesInRange(1, queryFromTime, queryToTime, samples));
+    BOOST_CHECK_EQUAL(samples.size(), STATS_TIER_SAMPLES[0] + 1);
+    BOOST_CHECK_EQUAL(samples.back().m_time_delta, 10U + 7199);
+
+    // the beginning is only left in the coarser tiers
+    queryFromTime = start;
+    queryToTime = start + 3600;
+    samples = stats.mempoolGetValuesInRange(queryFromTime, queryToTime);
+    BOOST_CHECK_EQUAL(samples.size(), 61U);
+    BOOST_CHECK_EQUAL(samples[1].m_time_delta - samples[0].m_time_delta, 60U);
+    BOOST_CHECK_EQUAL(samples[1].m_tx_accepted, 60U);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txdb.h>
+#include <uint256.h>
+#include <utilstrencodings.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, BasicTestingSetup)
+
+static void CheckSummary(CBlockTreeDB& db, const uint160& address, CAmount balance, CAmount received,
+                         CAmount sent, uint32_t txCount, int firstHeight, int lastHeight)
+{
+    CAddressSummaryValue summary;
+    BOOST_CHECK(db.ReadAddressSummary(address, 1, summary));
+    BOOST_CHECK_EQUAL(summary.balance, balance);
+    BOOST_CHECK_EQUAL(summary.received, received);
+    BOOST_CHECK_EQUAL(summary.sent, sent);
+    BOOST_CHECK_EQUAL(summary.txCount, txCount);
+    BOOST_CHECK_EQUAL(summary.firstHeight, firstHeight);
+    BOOST_CHECK_EQUAL(summary.lastHeight, lastHeight);
+}
+
+BOOST_AUTO_TEST_CASE(address_summary_connect_disconnect)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 address(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    const uint256 txid1 = uint256S("01");
+    const uint256 txid2 = uint256S("02");
+    const uint256 txid3 = uint256S("03");
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block1;
+    block1.push_back(std::make_pair(CAddressIndexKey(1, address, 1, 0, txid1, 0, false), 50 * COIN));
+    block1.push_back(std::make_pair(CAddressIndexKey(1, address, 1, 1, txid2, 1, false), 10 * COIN));
+
+    // Spend the first output and pay change back in the same transaction
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block3;
+    block3.push_back(std::make_pair(CAddressIndexKey(1, address, 3, 1, txid3, 0, true), -50 * COIN));
+    block3.push_back(std::make_pair(CAddressIndexKey(1, address, 3, 1, txid3, 1, false), 20 * COIN));
+
+    CheckSummary(db, address, 0, 0, 0, 0, -1, -1);
+
+    BOOST_CHECK(db.WriteAddressIndex(block1));
+    CheckSummary(db, address, 60 * COIN, 60 * COIN, 0, 2, 1, 1);
+    BOOST_CHECK(db.WriteAddressIndex(block3));
+    CheckSummary(db, address, 30 * COIN, 80 * COIN, 50 * COIN, 3, 1, 3);
+
+    // Connecting a block a second time must not count it twice
+    BOOST_CHECK(db.WriteAddressIndex(block3));
+    CheckSummary(db, address, 30 * COIN, 80 * COIN, 50 * COIN, 3, 1, 3);
+
+    // A rebuild from the deltas agrees with the incremental totals
+    BOOST_CHECK(db.BuildAddressSummaries());
+    CheckSummary(db, address, 30 * COIN, 80 * COIN, 50 * COIN, 3, 1, 3);
+
+    BOOST_CHECK(db.EraseAddressIndex(block3));
+    CheckSummary(db, address, 60 * COIN, 60 * COIN, 0, 2, 1, 1);
+    BOOST_CHECK(db.EraseAddressIndex(block3));
+    CheckSummary(db, address, 60 * COIN, 60 * COIN, 0, 2, 1, 1);
+
+    BOOST_CHECK(db.EraseAddressIndex(block1));
+    CheckSummary(db, address, 0, 0, 0, 0, -1, -1);
+}
+
+BOOST_AUTO_TEST_CASE(address_index_resume)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 address(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    const uint160 other(ParseHex("0102030405060708090a0b0c0d0e0f1011121315"));
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > entries;
+    for (int height = 1; height <= 10; height++) {
+        entries.push_back(std::make_pair(CAddressIndexKey(1, address, height, 0, uint256S("01"), 0, false), height));
+    }
+    entries.push_back(std::make_pair(CAddressIndexKey(1, other, 5, 0, uint256S("01"), 0, false), 100));
+    entries.push_back(std::make_pair(CAddressIndexKey(2, address, 5, 0, uint256S("01"), 0, false), 200));
+    BOOST_CHECK(db.WriteAddressIndex(entries));
+
+    // Page through in threes, resuming after the last key of each page
+    std::vector<int> heights;
+    CAddressIndexKey last;
+    bool fMore = true;
+    while (fMore) {
+        size_t nPage = 0;
+        fMore = false;
+        BOOST_CHECK(db.ReadAddressIndex(address, 1, heights.empty() ? nullptr : &last, 0, 0,
+            [&](const CAddressIndexKey& key, CAmount value) {
+                if (nPage == 3) {
+                    fMore = true;
+                    return false;
+                }
+                BOOST_CHECK_EQUAL(value, key.blockHeight);
+                heights.push_back(key.blockHeight);
+                last = key;
+                nPage++;
+                return true;
+            }));
+    }
+    BOOST_CHECK_EQUAL(heights.size(), 10U);
+    for (size_t i = 0; i < heights.size(); i++) {
+        BOOST_CHECK_EQUAL(heights[i], (int)i + 1);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
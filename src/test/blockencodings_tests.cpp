@@ -340,4 +340,110 @@ BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BOOST_CHECK_EQUAL(req1.indexes[3], req2.indexes[3]);
 }
 
+/** Compact block whose short IDs a test can overwrite */
+class TestCompactBlock : public CBlockHeaderAndShortTxIDs
+{
+public:
+    explicit TestCompactBlock(const CBlock& block) : CBlockHeaderAndShortTxIDs(block, false) {}
+
+    std::vector<uint64_t>& ShortIDs() { return shorttxids; }
+    std::vector<PrefilledTransaction>& PrefilledTxn() { return prefilledtxn; }
+};
+
+BOOST_FIXTURE_TEST_CASE(compactblock_max_shortid, BasicTestingSetup)
+{
+    // 0xffffffffffff is the largest short ID a peer can send. It has to be
+    // found in the short ID table and detected as a collision at every
+    // position, including the first one.
+    const uint64_t max_shortid = 0xffffffffffffULL;
+
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+    block.vtx.resize(3);
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        tx.vin[0].prevout.hash = InsecureRand256();
+        block.vtx[i] = MakeTransactionRef(tx);
+    }
+    block.nVersion = 1;
+    block.hashPrevBlock = InsecureRand256();
+    block.nBits = 0x1e0ffff0;
+
+    CTxMemPool pool;
+
+    {
+        TestCompactBlock cmpctblock(block);
+        cmpctblock.ShortIDs()[0] = max_shortid;
+        cmpctblock.ShortIDs()[1] = max_shortid;
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(cmpctblock, extra_txn) == READ_STATUS_FAILED);
+    }
+
+    {
+        TestCompactBlock cmpctblock(block);
+        cmpctblock.PrefilledTxn().clear();
+        cmpctblock.ShortIDs() = {max_shortid, cmpctblock.GetShortID(block.vtx[1]->GetHash()), max_shortid};
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(cmpctblock, extra_txn) == READ_STATUS_FAILED);
+    }
+
+    {
+        TestMemPoolEntryHelper entry;
+        pool.addUnchecked(block.vtx[2]->GetHash(), entry.FromTx(*block.vtx[2]));
+
+        TestCompactBlock cmpctblock(block);
+        cmpctblock.PrefilledTxn().clear();
+        cmpctblock.ShortIDs() = {max_shortid, cmpctblock.GetShortID(block.vtx[1]->GetHash()), cmpctblock.GetShortID(block.vtx[2]->GetHash())};
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(cmpctblock, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK(!partialBlock.IsTxAvailable(0));
+        BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+        BOOST_CHECK(partialBlock.IsTxAvailable(2));
+    }
+}
+
+/** Short ID table whose slots a test can fill directly */
+class TestShortTxIDTable : public ShortTxIDTable
+{
+public:
+    explicit TestShortTxIDTable(size_t count) : ShortTxIDTable(count) {}
+
+    size_t Capacity() const { return slots.size(); }
+    void SetSlot(size_t pos, uint64_t shortid, size_t index) { slots[pos] = (shortid << 16) | (index + 1); }
+};
+
+BOOST_FIXTURE_TEST_CASE(shorttxid_table_consecutive_run, BasicTestingSetup)
+{
+    // A peer can send short IDs that each sit in their own home slot but
+    // together make one long run of occupied slots. Lookups must give up
+    // after MAX_PROBES probes rather than walk the whole run.
+    const size_t count = 16000;
+    TestShortTxIDTable table(count);
+    const uint64_t capacity = table.Capacity();
+    for (size_t i = 0; i < count; i++)
+        BOOST_CHECK(table.Insert(i, i));
+    BOOST_CHECK_EQUAL(table.Find(0), 0);
+    BOOST_CHECK_EQUAL(table.Find(count - 1), (int)count - 1);
+    BOOST_CHECK_EQUAL(table.Find(capacity), -1);
+
+    // Past the run, a short ID MAX_PROBES slots from its home slot is the
+    // furthest Insert places one, and it is still found...
+    const uint64_t shortid_near = 3 * capacity + count - ShortTxIDTable::MAX_PROBES;
+    table.SetSlot(count, shortid_near, 1);
+    BOOST_CHECK_EQUAL(table.Find(shortid_near), 1);
+
+    // ...but lookups stop before one any further away
+    const uint64_t shortid_far = 5 * capacity + count - ShortTxIDTable::MAX_PROBES - 1;
+    table.SetSlot(count, shortid_far, 2);
+    BOOST_CHECK_EQUAL(table.Find(shortid_far), -1);
+    const uint64_t shortid_run = 7 * capacity;
+    table.SetSlot(count, shortid_run, 3);
+    BOOST_CHECK_EQUAL(table.Find(shortid_run), -1);
+
+    // So does inserting a short ID whose home slot is inside the run
+    BOOST_CHECK(!table.Insert(9 * capacity, 4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
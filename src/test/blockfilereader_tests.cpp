@@ -0,0 +1,125 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilereader.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <consensus/merkle.h>
+#include <streams.h>
+#include <util.h>
+#include <validation.h>
+#include <version.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilereader_tests, TestingSetup)
+
+static std::vector<unsigned char> Serialize(const CBlock& block)
+{
+    std::vector<unsigned char> data;
+    CVectorWriter(SER_DISK, CLIENT_VERSION, data, 0) << block;
+    return data;
+}
+
+static void CheckReadRawBlocks(bool fMapFiles)
+{
+    CBlockFileReader reader;
+    reader.SetMapFiles(fMapFiles);
+    const CBlock block1 = CreateTestBlock(uint256(), 1, 1600000000);
+    const CBlock block2 = CreateTestBlock(uint256(), 2, 1600000000);
+
+    CDiskBlockPos pos1 = AppendTestBlock(block1);
+    CRawBlock raw1;
+    BOOST_CHECK(reader.Read(pos1, raw1));
+    const std::vector<unsigned char> data1 = Serialize(block1);
+    BOOST_CHECK(std::vector<unsigned char>(raw1.begin(), raw1.end()) == data1);
+
+    CBlock read;
+    CSpanReader(SER_DISK, CLIENT_VERSION, raw1.begin(), raw1.end()) >> read;
+    BOOST_CHECK_EQUAL(read.GetHash(), block1.GetHash());
+
+    // When mapping, the second block lies past the end of the first mapping
+    CDiskBlockPos pos2 = AppendTestBlock(block2);
+    CRawBlock raw2;
+    BOOST_CHECK(reader.Read(pos2, raw2));
+    BOOST_CHECK(std::vector<unsigned char>(raw2.begin(), raw2.end()) == Serialize(block2));
+    // and the first one is still readable through the mapping it was read from
+    BOOST_CHECK(std::vector<unsigned char>(raw1.begin(), raw1.end()) == data1);
+
+    // Positions past the end of the file or of missing files fail
+    CRawBlock raw;
+    BOOST_CHECK(!reader.Read(CDiskBlockPos(0, pos2.nPos + raw2.size() + 8), raw));
+    BOOST_CHECK(!reader.Read(CDiskBlockPos(1, 8), raw));
+
+    reader.Forget(0);
+    BOOST_CHECK(reader.Read(pos1, raw));
+    BOOST_CHECK(std::vector<unsigned char>(raw.begin(), raw.end()) == data1);
+}
+
+BOOST_AUTO_TEST_CASE(read_raw_blocks)
+{
+    CheckReadRawBlocks(false);
+}
+
+BOOST_AUTO_TEST_CASE(read_raw_blocks_mapped)
+{
+    CheckReadRawBlocks(true);
+}
+
+BOOST_AUTO_TEST_CASE(strip_witness)
+{
+    CBlock block = CreateTestBlock(uint256(), 3, 1600000000);
+    CMutableTransaction coinbase(*block.vtx[0]);
+    coinbase.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(32, 0));
+    block.vtx[0] = MakeTransactionRef(coinbase);
+
+    CMutableTransaction spend;
+    spend.vin.resize(2);
+    spend.vin[0].prevout = COutPoint(coinbase.GetHash(), 0);
+    spend.vin[1].prevout = COutPoint(coinbase.GetHash(), 1);
+    spend.vin[1].scriptWitness.stack.push_back(std::vector<unsigned char>(72, 1));
+    spend.vin[1].scriptWitness.stack.push_back(std::vector<unsigned char>(300, 2));
+    spend.vout.resize(1);
+    spend.vout[0].nValue = COIN;
+    block.vtx.push_back(MakeTransactionRef(spend));
+
+    CMutableTransaction legacy;
+    legacy.vin.resize(1);
+    legacy.vin[0].prevout = COutPoint(spend.GetHash(), 0);
+    legacy.vin[0].scriptSig = CScript() << OP_1;
+    legacy.vout.resize(2);
+    legacy.nLockTime = 7;
+    block.vtx.push_back(MakeTransactionRef(legacy));
+
+    // Without inputs and outputs the vout count looks like a witness flag of 0
+    block.vtx.push_back(MakeTransactionRef(CMutableTransaction()));
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    const std::vector<unsigned char> data = Serialize(block);
+    CRawBlock raw(nullptr, data.data(), data.size());
+    std::vector<unsigned char> stripped;
+    BOOST_CHECK(raw.GetWithoutWitness(stripped));
+    std::vector<unsigned char> expected;
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS, expected, 0) << block;
+    BOOST_CHECK(stripped == expected);
+    BOOST_CHECK(stripped.size() < data.size());
+
+    // A block without witnesses comes out unchanged
+    CRawBlock rawStripped(nullptr, expected.data(), expected.size());
+    std::vector<unsigned char> again;
+    BOOST_CHECK(rawStripped.GetWithoutWitness(again));
+    BOOST_CHECK(again == expected);
+
+    // Truncated or trailing bytes fail
+    for (size_t nSize : {size_t(40), size_t(81), data.size() / 2, data.size() - 1}) {
+        BOOST_CHECK(!CRawBlock(nullptr, data.data(), nSize).GetWithoutWitness(stripped));
+    }
+    std::vector<unsigned char> trailing(data);
+    trailing.push_back(0);
+    BOOST_CHECK(!CRawBlock(nullptr, trailing.data(), trailing.size()).GetWithoutWitness(stripped));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
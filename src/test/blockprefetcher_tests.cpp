@@ -0,0 +1,121 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilereader.h>
+#include <blockprefetcher.h>
+#include <chainparams.h>
+#include <streams.h>
+#include <txdb.h>
+#include <util.h>
+#include <validation.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockprefetcher_tests, TestingSetup)
+
+/** Request a block and take it once it has been read */
+static bool TakeWhenRead(CBlockPrefetcher& prefetcher, const CBlockPrefetcher::Request& req, std::shared_ptr<const CBlock>& pblock, CCoinsViewCache& view)
+{
+    prefetcher.Prefetch({req});
+    return prefetcher.WaitForRead(req.hash) && prefetcher.Take(req.hash, pblock, view);
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_blocks_and_coins)
+{
+    // Drop what is mapped from the block files of earlier tests
+    g_block_file_reader.Forget(0);
+
+    CCoinsViewDB db(1 << 20, true);
+    const uint256 hashFunding = InsecureRand256();
+    {
+        CCoinsViewCache cache(&db);
+        for (uint32_t n = 0; n < 3; n++) {
+            cache.AddCoin(COutPoint(hashFunding, n), Coin(CTxOut(COIN, CScript() << OP_TRUE), 1, false), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    CMutableTransaction spend;
+    for (uint32_t n = 0; n < 3; n++) {
+        spend.vin.emplace_back(COutPoint(hashFunding, n));
+    }
+    spend.vout.resize(1);
+    spend.vout[0].nValue = COIN;
+    // Spends an output of the block itself, which isn't looked up
+    CMutableTransaction child;
+    child.vin.emplace_back(COutPoint(spend.GetHash(), 0));
+    child.vout.resize(1);
+    const CBlock block = CreateTestBlock(uint256(), 1, 1600000000, {MakeTransactionRef(spend), MakeTransactionRef(child)});
+
+    // The header isn't mined, so pretend its scrypt hash is known
+    CBlockPrefetcher::Request req{block.GetHash(), AppendTestBlock(block), uint256S("01")};
+
+    CBlockPrefetcher prefetcher(&db, Params().GetConsensus(), 4, 2);
+    std::shared_ptr<const CBlock> pblock;
+    CCoinsViewCache view(&db);
+    BOOST_CHECK(!prefetcher.Take(req.hash, pblock, view));
+
+    BOOST_REQUIRE(TakeWhenRead(prefetcher, req, pblock, view));
+    BOOST_CHECK_EQUAL(pblock->GetHash(), block.GetHash());
+    BOOST_CHECK_EQUAL(view.GetCacheSize(), 3U);
+    for (uint32_t n = 0; n < 3; n++) {
+        BOOST_CHECK(view.HaveCoinInCache(COutPoint(hashFunding, n)));
+    }
+    // Taken blocks are gone from the prefetcher
+    BOOST_CHECK(!prefetcher.Take(req.hash, pblock, view));
+
+    // Coins the cache already has an entry for are left alone, spent or not
+    CCoinsViewCache view2(&db);
+    BOOST_CHECK(view2.SpendCoin(COutPoint(hashFunding, 1)));
+    pblock.reset();
+    BOOST_REQUIRE(TakeWhenRead(prefetcher, req, pblock, view2));
+    BOOST_CHECK(view2.HaveCoinInCache(COutPoint(hashFunding, 0)));
+    BOOST_CHECK(!view2.HaveCoin(COutPoint(hashFunding, 1)));
+    BOOST_CHECK(view2.HaveCoinInCache(COutPoint(hashFunding, 2)));
+
+    // A block that doesn't match the request is left for the caller to read,
+    // also when it is carried over from an earlier window
+    CBlockPrefetcher::Request reqBad{InsecureRand256(), req.pos, req.hashPoW};
+    prefetcher.Prefetch({reqBad, req});
+    prefetcher.Prefetch({reqBad, req});
+    BOOST_REQUIRE(prefetcher.WaitForRead(reqBad.hash));
+    BOOST_REQUIRE(prefetcher.WaitForRead(req.hash));
+    BOOST_CHECK(!prefetcher.Take(reqBad.hash, pblock, view2));
+    pblock.reset();
+    BOOST_CHECK(prefetcher.Take(req.hash, pblock, view2));
+    BOOST_CHECK(pblock && pblock->GetHash() == block.GetHash());
+
+    // Coins are dropped when the database is written between reading and taking
+    prefetcher.Prefetch({req});
+    BOOST_REQUIRE(prefetcher.WaitForRead(req.hash));
+    {
+        CCoinsViewCache cache(&db);
+        cache.AddCoin(COutPoint(hashFunding, 3), Coin(CTxOut(COIN, CScript() << OP_TRUE), 1, false), false);
+        BOOST_CHECK(cache.SpendCoin(COutPoint(hashFunding, 0)));
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+    CCoinsViewCache view3(&db);
+    pblock.reset();
+    BOOST_CHECK(prefetcher.Take(req.hash, pblock, view3));
+    BOOST_CHECK(pblock && pblock->GetHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(view3.GetCacheSize(), 0U);
+    BOOST_CHECK(!view3.HaveCoin(COutPoint(hashFunding, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(coins_write_count)
+{
+    // The count is odd only while a write is under way, and moves on with every write
+    CCoinsViewDB db(1 << 20, true);
+    BOOST_CHECK_EQUAL(db.GetWriteCount() % 2, 0U);
+    uint64_t nWrites = db.GetWriteCount();
+    CCoinsMap mapCoins;
+    BOOST_CHECK(db.BatchWrite(mapCoins, InsecureRand256()));
+    BOOST_CHECK_EQUAL(db.GetWriteCount(), nWrites + 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
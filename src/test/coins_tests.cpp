@@ -855,4 +855,52 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_preload)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    // Two coins end up in the base view, a third one only in the cache
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 3; i++) {
+        Coin coin;
+        coin.out.nValue = i + 1;
+        coin.out.scriptPubKey.assign(i + 1, OP_TRUE);
+        coin.nHeight = i + 1;
+        outpoints.emplace_back(InsecureRand256(), i);
+        cache.AddCoin(outpoints.back(), std::move(coin), false);
+        if (i == 1) {
+            cache.SetBestBlock(InsecureRand256());
+            BOOST_CHECK(cache.Flush());
+        }
+    }
+    // Spending a coin of the base view leaves a spent entry, which is skipped
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    BOOST_CHECK(cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 3U);
+    cache.SelfTest();
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    cache.ForEachCachedCoin([&coins](const COutPoint& outpoint, const Coin& coin) {
+        coins.emplace_back(outpoint, coin);
+    });
+    BOOST_CHECK_EQUAL(coins.size(), 2U);
+
+    // Preloaded coins are served from the cache and are not written back
+    CCoinsViewCacheTest cache2(&base);
+    for (auto& entry : coins) {
+        COutPoint outpoint = entry.first;
+        BOOST_CHECK(cache2.PreloadCoin(outpoint, Coin(entry.second)));
+        BOOST_CHECK(!cache2.PreloadCoin(outpoint, Coin(entry.second)));
+        BOOST_CHECK(cache2.HaveCoinInCache(outpoint));
+        BOOST_CHECK_EQUAL(cache2.map().at(outpoint).flags, 0);
+    }
+    cache2.SelfTest();
+    BOOST_CHECK_EQUAL(cache2.GetCacheSize(), coins.size());
+    for (const auto& entry : coins) {
+        cache2.Uncache(entry.first);
+    }
+    BOOST_CHECK_EQUAL(cache2.GetCacheSize(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
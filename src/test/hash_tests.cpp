@@ -145,6 +145,27 @@ BOOST_AUTO_TEST_CASE(siphash)
         BOOST_CHECK_EQUAL(SipHashUint256(k1, k2, x), sip256.Finalize());
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }
+
+    // Check consistency between SipHashUint256 and SipHashUint256Batch, for
+    // counts that do and don't fill the last batch of lanes.
+    std::vector<uint256> vals(11);
+    std::vector<const uint256*> ptrs;
+    for (const uint256& val : vals) {
+        ptrs.push_back(&val);
+    }
+    for (size_t count = 0; count <= vals.size(); ++count) {
+        uint64_t k1 = ctx.rand64();
+        uint64_t k2 = ctx.rand64();
+        for (uint256& val : vals) {
+            val = InsecureRand256();
+        }
+        std::vector<uint64_t> out(count + 1, 0);
+        SipHashUint256Batch(k1, k2, ptrs.data(), count, out.data());
+        for (size_t i = 0; i < count; ++i) {
+            BOOST_CHECK_EQUAL(out[i], SipHashUint256(k1, k2, vals[i]));
+        }
+        BOOST_CHECK_EQUAL(out[count], 0U);
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,111 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
+#include <sync.h>
+#include <test/test_bitcoin.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <thread>
+
+#include <univalue.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    UniValue doc;
+    BOOST_CHECK(doc.read("{\"a\":1,\"b\":[true,false,null,\"x\\\"y\"],\"c\":{},\"d\":[],"
+                         "\"e\":{\"f\":[{\"g\":-1.5},[[]]]},\"h\\n\":\"\"}"));
+
+    // Small chunks exercise flushing in the middle of the document
+    std::vector<std::string> chunks;
+    JSONStreamWriter writer([&chunks](const std::string& chunk) { chunks.push_back(chunk); }, 8);
+    writer.Value(doc);
+    writer.Flush();
+
+    std::string out;
+    for (const std::string& chunk : chunks) {
+        BOOST_CHECK(!chunk.empty());
+        out += chunk;
+    }
+    BOOST_CHECK(chunks.size() > 1);
+    BOOST_CHECK_EQUAL(out, doc.write());
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_incremental)
+{
+    std::string out;
+    JSONStreamWriter writer([&out](const std::string& chunk) { out += chunk; });
+    writer.BeginObject();
+    writer.Key("result");
+    writer.BeginArray();
+    for (int i = 0; i < 3; i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("n", i);
+        writer.Value(entry);
+    }
+    writer.EndArray();
+    writer.Key("error");
+    writer.Value(NullUniValue);
+    writer.Key("id");
+    writer.RawValue("7");
+    writer.EndObject();
+    writer.Raw("\n");
+    BOOST_CHECK(out.empty());
+    writer.Flush();
+    BOOST_CHECK_EQUAL(out, "{\"result\":[{\"n\":0},{\"n\":1},{\"n\":2}],\"error\":null,\"id\":7}\n");
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_mempool_unlocked)
+{
+    // More entries than one batch, so that entries are built again after
+    // a batch was written
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1000;
+    for (size_t i = 0; i < MEMPOOL_JSON_STREAM_BATCH_SIZE + 10; i++) {
+        tx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+        LOCK(mempool.cs);
+        mempool.addUnchecked(tx.GetHash(), entry.Fee(1000).FromTx(tx));
+    }
+
+    // Writes wait for the client, so mempool.cs must be free for other
+    // threads whenever a chunk is handed to the sink
+    std::string out;
+    size_t nChunks = 0, nLocked = 0;
+    JSONStreamWriter writer([&](const std::string& chunk) {
+        bool fFree = false;
+        std::thread([&fFree] {
+            TRY_LOCK(mempool.cs, lockMempool);
+            fFree = lockMempool;
+        }).join();
+        if (!fFree)
+            nLocked++;
+        nChunks++;
+        out += chunk;
+    }, 4096);
+    mempoolToJSONStream(writer);
+    writer.Flush();
+    BOOST_CHECK(nChunks > 1);
+    BOOST_CHECK_EQUAL(nLocked, 0U);
+
+    UniValue streamed;
+    BOOST_CHECK(streamed.read(out));
+    const UniValue expected = mempoolToJSON(true);
+    BOOST_CHECK_EQUAL(streamed.size(), MEMPOOL_JSON_STREAM_BATCH_SIZE + 10);
+    BOOST_CHECK_EQUAL(streamed.size(), expected.size());
+    for (const std::string& key : expected.getKeys())
+        BOOST_CHECK_EQUAL(streamed[key].write(), expected[key].write());
+
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,10 +2,17 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockfilereader.h>
 #include <chainparams.h>
+#include <clientversion.h>
+#include <consensus/validation.h>
+#include <streams.h>
+#include <util.h>
 #include <validation.h>
 #include <net.h>
 
+#include <set>
+
 #include <test/test_bitcoin.h>
 
 #include <boost/signals2/signal.hpp>
@@ -74,4 +81,67 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+/**
+ * Reindex block file 0 with blocks 1 to 3 of the test chain appended to it,
+ * block 2 first and block 1 hidden in a record that doesn't deserialize,
+ * using nThreads import threads. Returns the blocks that have data.
+ */
+static std::set<uint256> ImportTestChain(int nThreads)
+{
+    const CChainParams& chainparams = Params();
+    const std::vector<CBlock> chain = CreateTestChain();
+    // Drop what is mapped from the block files of earlier tests
+    g_block_file_reader.Forget(0);
+
+    AppendTestBlock(chain[1]);
+    {
+        // A block header followed by an impossible transaction count, then block 1
+        CDataStream record(SER_DISK, CLIENT_VERSION);
+        record << chain[0].GetBlockHeader();
+        record.insert(record.end(), 9, (char)0xff);
+        record << FLATDATA(chainparams.MessageStart()) << (unsigned int)GetSerializeSize(chain[0], SER_DISK, CLIENT_VERSION) << chain[0];
+        CAutoFile fileout(fsbridge::fopen(GetBlockPosFilename(CDiskBlockPos(0, 0), "blk"), "ab"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!fileout.IsNull());
+        fileout << FLATDATA(chainparams.MessageStart()) << (unsigned int)record.size();
+        fileout.write(record.data(), record.size());
+    }
+    AppendTestBlock(chain[2]);
+
+    gArgs.ForceSetArg("-importthreads", std::to_string(nThreads));
+    CDiskBlockPos pos(0, 0);
+    BOOST_CHECK(LoadExternalBlockFile(chainparams, fsbridge::fopen(GetBlockPosFilename(pos, "blk"), "rb"), &pos));
+    gArgs.ForceSetArg("-importthreads", std::to_string(DEFAULT_IMPORT_THREADS));
+    CValidationState state;
+    BOOST_CHECK(ActivateBestChain(state, chainparams));
+
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == chain[2].GetHash());
+    std::set<uint256> setHaveData;
+    for (const std::pair<const uint256, CBlockIndex*>& entry : mapBlockIndex) {
+        if (entry.second->nStatus & BLOCK_HAVE_DATA)
+            setHaveData.insert(entry.first);
+    }
+    return setHaveData;
+}
+
+static std::set<uint256> TestChainHashes()
+{
+    std::set<uint256> setHashes = {Params().GenesisBlock().GetHash()};
+    for (const CBlock& block : CreateTestChain()) {
+        setHashes.insert(block.GetHash());
+    }
+    return setHashes;
+}
+
+BOOST_AUTO_TEST_CASE(load_external_block_file_one_thread)
+{
+    BOOST_CHECK(ImportTestChain(1) == TestChainHashes());
+}
+
+BOOST_AUTO_TEST_CASE(load_external_block_file_threads)
+{
+    BOOST_CHECK(ImportTestChain(4) == TestChainHashes());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,7 +4,9 @@
 
 #include <policy/policy.h>
 #include <txmempool.h>
+#include <validation.h>
 #include <util.h>
+#include <utilstrencodings.h>
 
 #include <test/test_bitcoin.h>
 
@@ -571,4 +573,263 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAddressSpentIndexTest)
+{
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    const uint160 payer(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    const uint160 payee(ParseHex("1112131415161718191a1b1c1d1e1f2021222324"));
+    const CScript payerScript = CScript() << OP_DUP << OP_HASH160 << ToByteVector(payer) << OP_EQUALVERIFY << OP_CHECKSIG;
+    const CScript payeeScript = CScript() << OP_HASH160 << ToByteVector(payee) << OP_EQUAL;
+
+    CCoinsView base;
+    CCoinsViewCache view(&base);
+    const COutPoint prevout(uint256S("01"), 3);
+    view.AddCoin(prevout, Coin(CTxOut(50 * COIN, payerScript), 1, false), false);
+
+    // Pays the same address twice and returns change to the payer
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(3);
+    tx.vout[0] = CTxOut(10 * COIN, payeeScript);
+    tx.vout[1] = CTxOut(20 * COIN, payeeScript);
+    tx.vout[2] = CTxOut(19 * COIN, payerScript);
+
+    const CTxMemPoolEntry txEntry = entry.Time(7).FromTx(tx);
+    pool.addUnchecked(tx.GetHash(), txEntry);
+    size_t nUsageBefore = pool.DynamicMemoryUsage();
+    pool.addAddressIndex(txEntry, view);
+    pool.addSpentIndex(txEntry, view);
+    BOOST_CHECK(pool.DynamicMemoryUsage() > nUsageBefore);
+
+    std::vector<std::pair<uint160, int> > addresses;
+    addresses.push_back(std::make_pair(payer, 1));
+    addresses.push_back(std::make_pair(payee, 2));
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > deltas;
+    BOOST_CHECK(pool.getAddressIndex(addresses, deltas));
+    BOOST_CHECK_EQUAL(deltas.size(), 4U);
+    CAmount payerTotal = 0, payeeTotal = 0;
+    for (const auto& delta : deltas) {
+        BOOST_CHECK(delta.first.txhash == tx.GetHash());
+        BOOST_CHECK_EQUAL(delta.second.time, 7);
+        if (delta.first.addressBytes == payer) {
+            BOOST_CHECK_EQUAL(delta.first.type, 1);
+            payerTotal += delta.second.amount;
+            if (delta.first.spending) {
+                BOOST_CHECK(delta.second.prevhash == prevout.hash);
+                BOOST_CHECK_EQUAL(delta.second.prevout, prevout.n);
+            }
+        } else {
+            BOOST_CHECK_EQUAL(delta.first.type, 2);
+            payeeTotal += delta.second.amount;
+        }
+    }
+    BOOST_CHECK_EQUAL(payerTotal, -31 * COIN);
+    BOOST_CHECK_EQUAL(payeeTotal, 30 * COIN);
+
+    CSpentIndexKey key(prevout.hash, prevout.n);
+    CSpentIndexValue value;
+    BOOST_CHECK(pool.getSpentIndex(key, value));
+    BOOST_CHECK(value.txid == tx.GetHash());
+    BOOST_CHECK_EQUAL(value.inputIndex, 0U);
+    BOOST_CHECK_EQUAL(value.satoshis, 50 * COIN);
+    BOOST_CHECK_EQUAL(value.addressType, 1);
+    BOOST_CHECK(value.addressHash == payer);
+
+    // Removing the transaction from the mempool drops it from both indexes
+    pool.removeRecursive(tx);
+    deltas.clear();
+    BOOST_CHECK(pool.getAddressIndex(addresses, deltas));
+    BOOST_CHECK(deltas.empty());
+    BOOST_CHECK(!pool.getSpentIndex(key, value));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterTest)
+{
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    // check() verifies the clusters against the links
+    pool.setSanityCheck(1.0);
+    CCoinsViewCache coins(pcoinsTip.get());
+    coins.AddCoin(COutPoint(uint256S("01"), 0), Coin(CTxOut(COIN, CScript()), 1, false), false);
+    coins.AddCoin(COutPoint(uint256S("02"), 0), Coin(CTxOut(COIN, CScript()), 1, false), false);
+
+    auto make_tx = [](const std::vector<COutPoint>& prevouts, CAmount nValue) {
+        CMutableTransaction tx;
+        tx.vin.resize(prevouts.size());
+        for (size_t i = 0; i < prevouts.size(); i++) {
+            tx.vin[i].prevout = prevouts[i];
+            tx.vin[i].scriptSig = CScript() << OP_11;
+        }
+        tx.vout.resize(2);
+        for (size_t i = 0; i < 2; i++) {
+            tx.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+            tx.vout[i].nValue = nValue;
+        }
+        return CTransaction(tx);
+    };
+    auto cluster_count = [&pool](const CTransaction& tx) {
+        uint64_t nCount, nSize;
+        CAmount nFees;
+        pool.GetClusterState(*pool.mapTx.find(tx.GetHash()), nCount, nSize, nFees);
+        return nCount;
+    };
+    auto cluster_fees = [&pool](const CTransaction& tx) {
+        uint64_t nCount, nSize;
+        CAmount nFees;
+        pool.GetClusterState(*pool.mapTx.find(tx.GetHash()), nCount, nSize, nFees);
+        return nFees;
+    };
+
+    // Chain a -> b -> c, and d on its own
+    CTransaction a = make_tx({COutPoint(uint256S("01"), 0)}, 100000);
+    CTransaction b = make_tx({COutPoint(a.GetHash(), 0)}, 10000);
+    CTransaction c = make_tx({COutPoint(b.GetHash(), 0)}, 1000);
+    CTransaction d = make_tx({COutPoint(uint256S("02"), 0)}, 100000);
+    pool.addUnchecked(a.GetHash(), entry.Fee(1000).FromTx(a));
+    pool.addUnchecked(b.GetHash(), entry.Fee(2000).FromTx(b));
+    pool.addUnchecked(c.GetHash(), entry.Fee(3000).FromTx(c));
+    pool.addUnchecked(d.GetHash(), entry.Fee(4000).FromTx(d));
+    BOOST_CHECK_EQUAL(cluster_count(a), 3U);
+    BOOST_CHECK_EQUAL(cluster_count(c), 3U);
+    BOOST_CHECK_EQUAL(cluster_count(d), 1U);
+    BOOST_CHECK_EQUAL(cluster_fees(b), 6000);
+    pool.check(&coins);
+
+    pool.PrioritiseTransaction(b.GetHash(), 500);
+    BOOST_CHECK_EQUAL(cluster_fees(a), 6500);
+
+    // e joins a's and d's clusters
+    CTransaction e = make_tx({COutPoint(a.GetHash(), 1), COutPoint(d.GetHash(), 0)}, 10000);
+    pool.addUnchecked(e.GetHash(), entry.Fee(5000).FromTx(e));
+    BOOST_CHECK_EQUAL(cluster_count(d), 5U);
+    BOOST_CHECK_EQUAL(cluster_fees(d), 15500);
+    pool.check(&coins);
+
+    // Removing b takes c with it, leaving a, d and e connected
+    pool.removeRecursive(b);
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    BOOST_CHECK_EQUAL(cluster_count(a), 3U);
+    BOOST_CHECK_EQUAL(cluster_fees(a), 10000);
+    pool.check(&coins);
+
+    // Without e, a and d are no longer connected
+    pool.removeRecursive(e);
+    BOOST_CHECK_EQUAL(cluster_count(a), 1U);
+    BOOST_CHECK_EQUAL(cluster_count(d), 1U);
+    BOOST_CHECK_EQUAL(cluster_fees(d), 4000);
+    pool.check(&coins);
+
+    // Evicting a whole chain leaves nothing behind
+    CTransaction f = make_tx({COutPoint(a.GetHash(), 0)}, 10000);
+    pool.addUnchecked(f.GetHash(), entry.Fee(1000).FromTx(f));
+    BOOST_CHECK_EQUAL(cluster_count(f), 2U);
+    pool.TrimToSize(0);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+
+    // Parents p0..pN-1, where child ci spends from pi and pi+1, are all one
+    // cluster, which a block confirming every parent breaks into the children
+    const int N = 50;
+    std::vector<CTransaction> parents, children;
+    for (int i = 0; i < N; i++) {
+        COutPoint prevout(uint256S(strprintf("%x", 0x100 + i)), 0);
+        coins.AddCoin(prevout, Coin(CTxOut(COIN, CScript()), 1, false), false);
+        parents.push_back(make_tx({prevout}, 100000));
+        pool.addUnchecked(parents.back().GetHash(), entry.Fee(1000).FromTx(parents.back()));
+    }
+    for (int i = 0; i + 1 < N; i++) {
+        children.push_back(make_tx({COutPoint(parents[i].GetHash(), 0), COutPoint(parents[i + 1].GetHash(), 1)}, 10000));
+        pool.addUnchecked(children.back().GetHash(), entry.Fee(2000).FromTx(children.back()));
+    }
+    // The last child also has a child of its own
+    CTransaction g = make_tx({COutPoint(children.back().GetHash(), 0)}, 1000);
+    pool.addUnchecked(g.GetHash(), entry.Fee(3000).FromTx(g));
+    BOOST_CHECK_EQUAL(cluster_count(parents[0]), 2U * N);
+    pool.check(&coins);
+
+    std::vector<CTransactionRef> vtx;
+    for (const CTransaction& parent : parents) {
+        vtx.push_back(MakeTransactionRef(parent));
+        for (uint32_t n = 0; n < 2; n++) {
+            coins.AddCoin(COutPoint(parent.GetHash(), n), Coin(parent.vout[n], 2, false), false);
+        }
+    }
+    pool.removeForBlock(vtx, 2);
+    BOOST_CHECK_EQUAL(pool.size(), (size_t)N);
+    for (size_t i = 0; i + 1 < children.size(); i++) {
+        BOOST_CHECK_EQUAL(cluster_count(children[i]), 1U);
+        BOOST_CHECK_EQUAL(cluster_fees(children[i]), 2000);
+    }
+    BOOST_CHECK_EQUAL(cluster_count(g), 2U);
+    BOOST_CHECK_EQUAL(cluster_fees(children.back()), 5000);
+    pool.check(&coins);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolFeeHistogramTest)
+{
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    // check() recomputes both histograms from the entries
+    pool.setSanityCheck(1.0);
+    CCoinsViewCache coins(pcoinsTip.get());
+    coins.AddCoin(COutPoint(uint256S("01"), 0), Coin(CTxOut(COIN, CScript()), 1, false), false);
+
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(uint256S("01"), 0);
+    tx1.vin[0].scriptSig = CScript() << OP_11;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = COIN / 2;
+    CMutableTransaction tx2 = tx1;
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+
+    // Both have the same size, so the child's fee buys it twice the feerate
+    // with its ancestors that it pays on its own
+    int64_t nSize = GetVirtualTransactionSize(CTransaction(tx1));
+    BOOST_CHECK_EQUAL(nSize, GetVirtualTransactionSize(CTransaction(tx2)));
+    pool.addUnchecked(tx1.GetHash(), entry.Fee(0).FromTx(tx1));
+    pool.addUnchecked(tx2.GetHash(), entry.Fee(20 * nSize).FromTx(tx2));
+    pool.check(&coins);
+
+    FeeHistogram modified, ancestor;
+    pool.GetFeeHistograms(modified, ancestor);
+    BOOST_CHECK_EQUAL(modified[0].nCount, 1U);
+    BOOST_CHECK_EQUAL(modified[10].nCount, 1U);
+    BOOST_CHECK_EQUAL(modified[10].nSize, (uint64_t)nSize);
+    BOOST_CHECK_EQUAL(modified[10].nFees, 20 * nSize);
+    BOOST_CHECK_EQUAL(ancestor[0].nCount, 1U);
+    BOOST_CHECK_EQUAL(ancestor[8].nCount, 1U);
+    BOOST_CHECK_EQUAL(ancestor[8].nSize, (uint64_t)nSize);
+    BOOST_CHECK_EQUAL(ancestor[8].nFees, 20 * nSize);
+
+    // Prioritising the parent moves both transactions' ancestor buckets
+    pool.PrioritiseTransaction(tx1.GetHash(), 20 * nSize);
+    pool.check(&coins);
+    pool.GetFeeHistograms(modified, ancestor);
+    BOOST_CHECK_EQUAL(modified[0].nCount, 0U);
+    BOOST_CHECK_EQUAL(modified[10].nCount, 2U);
+    BOOST_CHECK_EQUAL(modified[10].nFees, 40 * nSize);
+    BOOST_CHECK_EQUAL(ancestor[8].nCount, 0U);
+    BOOST_CHECK_EQUAL(ancestor[10].nCount, 2U);
+
+    // Removing the parent takes the child with it
+    pool.removeRecursive(tx1);
+    pool.check(&coins);
+    pool.GetFeeHistograms(modified, ancestor);
+    for (int i = 0; i < FEE_HISTOGRAM_BUCKETS; i++) {
+        BOOST_CHECK_EQUAL(modified[i].nCount, 0U);
+        BOOST_CHECK_EQUAL(modified[i].nSize, 0U);
+        BOOST_CHECK_EQUAL(ancestor[i].nCount, 0U);
+        BOOST_CHECK_EQUAL(ancestor[i].nFees, 0);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,204 @@
+// Copyright (c) 2020 The Beyondcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <coins.h>
+#include <mempooljournal.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <util.h>
+#include <validation.h>
+#include <validationinterface.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mempooljournal_tests, TestingSetup)
+
+static CTransactionRef MakeTx(int n)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(uint256S("01"), n);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = 1000 * n;
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(journal_replay)
+{
+    TestMemPoolEntryHelper entry;
+    const CTransactionRef txA = MakeTx(1);
+    const CTransactionRef txB = MakeTx(2);
+    const CTransactionRef txC = MakeTx(3);
+    mempool.addUnchecked(txA->GetHash(), entry.Time(100).FromTx(*txA));
+    mempool.addUnchecked(txB->GetHash(), entry.Time(200).FromTx(*txB));
+
+    const fs::path path = pathTemp / MEMPOOL_JOURNAL_FILENAME;
+    {
+        CMempoolJournal journal(path);
+        RegisterValidationInterface(&journal);
+        BOOST_CHECK(journal.Start());
+
+        // One transaction arrives, another one is mined
+        GetMainSignals().TransactionAddedToMempool(txC);
+        auto pblock = std::make_shared<CBlock>();
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vout.resize(1);
+        pblock->vtx.push_back(MakeTransactionRef(coinbase));
+        pblock->vtx.push_back(txA);
+        GetMainSignals().BlockConnected(pblock, nullptr, std::make_shared<const std::vector<CTransactionRef> >());
+        SyncWithValidationInterfaceQueue();
+
+        UnregisterValidationInterface(&journal);
+        journal.Stop();
+    }
+
+    std::vector<MempoolDiskEntry> entries;
+    std::map<uint256, CAmount> mapDeltas;
+    BOOST_CHECK(CMempoolJournal::Read(path, entries, mapDeltas));
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+    BOOST_CHECK(entries[0].tx->GetHash() == txB->GetHash());
+    BOOST_CHECK_EQUAL(entries[0].nTime, 200);
+    BOOST_CHECK(entries[1].tx->GetHash() == txC->GetHash());
+    BOOST_CHECK(mapDeltas.empty());
+
+    // A record torn by a crash is ignored
+    FILE* file = fsbridge::fopen(path, "ab");
+    BOOST_CHECK(file);
+    const unsigned char torn[] = {'a', 0xff, 0x00, 0x00};
+    BOOST_CHECK_EQUAL(fwrite(torn, 1, sizeof(torn), file), sizeof(torn));
+    fclose(file);
+    entries.clear();
+    BOOST_CHECK(CMempoolJournal::Read(path, entries, mapDeltas));
+    BOOST_CHECK_EQUAL(entries.size(), 2U);
+
+    mempool.clear();
+}
+
+/** Journal that a test can compact at any time */
+class TestMempoolJournal : public CMempoolJournal
+{
+public:
+    explicit TestMempoolJournal(const fs::path& pathIn) : CMempoolJournal(pathIn) {}
+
+    using CMempoolJournal::Compact;
+};
+
+BOOST_AUTO_TEST_CASE(journal_compact)
+{
+    TestMemPoolEntryHelper entry;
+    const CTransactionRef txA = MakeTx(1);
+    const CTransactionRef txB = MakeTx(2);
+    const CTransactionRef txC = MakeTx(3);
+    mempool.addUnchecked(txA->GetHash(), entry.Time(100).FromTx(*txA));
+    mempool.addUnchecked(txB->GetHash(), entry.Time(200).FromTx(*txB));
+
+    const fs::path path = pathTemp / MEMPOOL_JOURNAL_FILENAME;
+    fs::path pathNew = path;
+    pathNew += ".new";
+    {
+        TestMempoolJournal journal(path);
+        RegisterValidationInterface(&journal);
+        BOOST_CHECK(journal.Start());
+        const uint64_t nStartSize = fs::file_size(path);
+
+        // Transactions coming and getting mined make the journal grow
+        auto pblock = std::make_shared<CBlock>();
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vout.resize(1);
+        pblock->vtx.push_back(MakeTransactionRef(coinbase));
+        for (int i = 0; i < 100; i++) {
+            const CTransactionRef tx = MakeTx(100 + i);
+            GetMainSignals().TransactionAddedToMempool(tx);
+            pblock->vtx.push_back(tx);
+        }
+        GetMainSignals().BlockConnected(pblock, nullptr, std::make_shared<const std::vector<CTransactionRef> >());
+        SyncWithValidationInterfaceQueue();
+        BOOST_CHECK(fs::file_size(path) > nStartSize);
+
+        // Compacting replaces the journal while it is open for appending,
+        // and later records go to the new file
+        BOOST_CHECK(journal.Compact());
+        BOOST_CHECK_EQUAL(fs::file_size(path), nStartSize);
+        BOOST_CHECK(!fs::exists(pathNew));
+        GetMainSignals().TransactionAddedToMempool(txC);
+        SyncWithValidationInterfaceQueue();
+        BOOST_CHECK(fs::file_size(path) > nStartSize);
+        BOOST_CHECK(!journal.IsFailed());
+
+        UnregisterValidationInterface(&journal);
+        journal.Stop();
+    }
+
+    std::vector<MempoolDiskEntry> entries;
+    std::map<uint256, CAmount> mapDeltas;
+    BOOST_CHECK(CMempoolJournal::Read(path, entries, mapDeltas));
+    BOOST_REQUIRE_EQUAL(entries.size(), 3U);
+    std::set<uint256> setSnapshot = {entries[0].tx->GetHash(), entries[1].tx->GetHash()};
+    BOOST_CHECK(setSnapshot == std::set<uint256>({txA->GetHash(), txB->GetHash()}));
+    BOOST_CHECK(entries[2].tx->GetHash() == txC->GetHash());
+
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_CASE(load_mempool_batches)
+{
+    // The inputs are in the coins database, not in the cache
+    std::vector<COutPoint> vCoins;
+    for (size_t i = 0; i < MEMPOOL_LOAD_BATCH_SIZE + 1; i++)
+        vCoins.push_back(AddTestCoin(COIN));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->Flush());
+    }
+
+    // A child is in the first batch and its parent in the second one, so
+    // the child only gets in when it is retried. An orphan never does, and
+    // a transaction spending more than its input is rejected.
+    const CMutableTransaction parent = CreateTestSpend({vCoins[0]}, COIN - 10000);
+    const CMutableTransaction child = CreateTestSpend({COutPoint(parent.GetHash(), 0)}, COIN - 20000);
+    const CMutableTransaction orphan = CreateTestSpend({COutPoint(InsecureRand256(), 0)}, COIN - 10000);
+    const CMutableTransaction invalid = CreateTestSpend({vCoins[1]}, 2 * COIN);
+    std::vector<CMutableTransaction> vtx = {child};
+    for (size_t i = 2; i < vCoins.size(); i++)
+        vtx.push_back(CreateTestSpend({vCoins[i]}, COIN - 10000));
+    vtx.push_back(parent);
+    vtx.push_back(orphan);
+    vtx.push_back(invalid);
+    BOOST_CHECK_EQUAL(vtx.size(), MEMPOOL_LOAD_BATCH_SIZE + 3);
+
+    {
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "mempool.dat", "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file << (uint64_t)1 << (uint64_t)vtx.size();
+        for (const CMutableTransaction& tx : vtx)
+            file << MempoolDiskEntry{MakeTransactionRef(tx), GetTime(), 0};
+        file << std::map<uint256, CAmount>();
+    }
+
+    BOOST_CHECK(LoadMempool());
+    BOOST_CHECK_EQUAL(mempool.size(), MEMPOOL_LOAD_BATCH_SIZE + 1);
+    BOOST_CHECK(mempool.exists(parent.GetHash()));
+    BOOST_CHECK(mempool.exists(child.GetHash()));
+    BOOST_CHECK(!mempool.exists(orphan.GetHash()));
+    BOOST_CHECK(!mempool.exists(invalid.GetHash()));
+
+    // Inputs stay cached only for transactions that got in
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(vCoins[0]));
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(vCoins[2]));
+        BOOST_CHECK(!pcoinsTip->HaveCoinInCache(vCoins[1]));
+    }
+
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
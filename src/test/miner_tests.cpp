@@ -11,16 +11,20 @@
 #include <validation.h>
 #include <miner.h>
 #include <policy/policy.h>
+#include <policy/rbf.h>
 #include <pubkey.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <utiltime.h>
+#include <validationinterface.h>
 
 #include <test/test_bitcoin.h>
 
 #include <memory>
+#include <set>
 
 #include <boost/test/unit_test.hpp>
 
@@ -520,4 +524,101 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+/** Wait for the cached template to catch up with the mempool, and compare it with a fresh one */
+static void CheckCachedTemplate(const CChainParams& chainparams, BlockTemplateCache& cache)
+{
+    SyncWithValidationInterfaceQueue();
+    const CBlockIndex* pindexPrev;
+    {
+        LOCK(cs_main);
+        pindexPrev = chainActive.Tip();
+    }
+    std::shared_ptr<const CBlockTemplate> pcached;
+    unsigned int nTransactionsUpdated = 0;
+    for (int i = 0; i < 1000; i++) {
+        pcached = cache.GetTemplate(pindexPrev, nTransactionsUpdated, 5000);
+        if (pcached && nTransactionsUpdated == mempool.GetTransactionsUpdated())
+            break;
+        MilliSleep(10);
+    }
+    BOOST_REQUIRE(pcached);
+    BOOST_CHECK_EQUAL(nTransactionsUpdated, mempool.GetTransactionsUpdated());
+
+    std::unique_ptr<CBlockTemplate> pfresh = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE);
+    BOOST_CHECK(pcached->block.hashPrevBlock == pfresh->block.hashPrevBlock);
+    // Transactions appended to the cached template may be in another order
+    std::set<uint256> setCached;
+    std::set<uint256> setFresh;
+    for (size_t i = 1; i < pcached->block.vtx.size(); i++) {
+        setCached.insert(pcached->block.vtx[i]->GetHash());
+    }
+    for (size_t i = 1; i < pfresh->block.vtx.size(); i++) {
+        setFresh.insert(pfresh->block.vtx[i]->GetHash());
+    }
+    BOOST_CHECK(setCached == setFresh);
+    BOOST_CHECK_EQUAL(pcached->vTxFees[0], pfresh->vTxFees[0]);
+    BOOST_CHECK_EQUAL(pcached->block.vtx[0]->GetValueOut(), pfresh->block.vtx[0]->GetValueOut());
+}
+
+BOOST_AUTO_TEST_CASE(BlockTemplateCache_matches_CreateNewBlock)
+{
+    const CChainParams& chainparams = Params();
+    const std::vector<CBlock> chain = CreateTestChain();
+    mempool.clear();
+    // No templates are built during the initial block download
+    SetMockTime(chain.back().nTime);
+    BOOST_REQUIRE(ProcessNewBlock(chainparams, std::make_shared<const CBlock>(chain[0]), true, nullptr));
+
+    GetMainSignals().RegisterWithMempoolSignals(mempool);
+    BlockTemplateCache cache(chainparams);
+    RegisterValidationInterface(&cache);
+    cache.Start();
+    CheckCachedTemplate(chainparams, cache);
+
+    // A child arriving after its parent is appended to the template
+    const COutPoint funding1 = AddTestCoin(COIN);
+    const COutPoint funding2 = AddTestCoin(COIN);
+    CMutableTransaction parent = CreateTestSpend({funding1}, COIN - 10000);
+    parent.vin[0].nSequence = MAX_BIP125_RBF_SEQUENCE;
+    const CMutableTransaction child = CreateTestSpend({COutPoint(parent.GetHash(), 0)}, COIN - 30000);
+    const CMutableTransaction other = CreateTestSpend({funding2}, COIN - 20000);
+    for (const CMutableTransaction& tx : {parent, child, other}) {
+        CValidationState state;
+        LOCK(cs_main);
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), nullptr /* pfMissingInputs */,
+                                       nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "");
+    }
+    CheckCachedTemplate(chainparams, cache);
+
+    // Replacing the parent removes both it and its child
+    fEnableReplacement = true;
+    const CMutableTransaction replacement = CreateTestSpend({funding1}, COIN - 50000);
+    {
+        CValidationState state;
+        LOCK(cs_main);
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(replacement), nullptr /* pfMissingInputs */,
+                                       nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "");
+        BOOST_CHECK(!mempool.exists(child.GetHash()));
+    }
+    fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
+    CheckCachedTemplate(chainparams, cache);
+
+    // A new tip takes the mempool over to a rebuilt template
+    BOOST_REQUIRE(ProcessNewBlock(chainparams, std::make_shared<const CBlock>(chain[1]), true, nullptr));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == chain[1].GetHash());
+    }
+    CheckCachedTemplate(chainparams, cache);
+    BOOST_CHECK_EQUAL(mempool.size(), 2U);
+
+    UnregisterValidationInterface(&cache);
+    cache.Stop();
+    GetMainSignals().UnregisterWithMempoolSignals(mempool);
+    mempool.clear();
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,8 @@
 
 #include <policy/policy.h>
 #include <policy/fees.h>
+#include <clientversion.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util.h>
@@ -14,9 +16,33 @@
 
 BOOST_FIXTURE_TEST_SUITE(policyestimator_tests, BasicTestingSetup)
 
+class CBlockPolicyEstimatorTest : public CBlockPolicyEstimator
+{
+public:
+    /** Compare the cached estimateSmartFee results with ones computed from the current stats */
+    void CheckSmartFeeTable() const
+    {
+        LOCK(cs_feeEstimator);
+        // One past the highest target tracked is never cached
+        for (int target = 0; target <= (int)HighestTargetTracked(FeeEstimateHorizon::LONG_HALFLIFE) + 1; target++) {
+            for (bool conservative : {false, true}) {
+                // The first request fills the cache and the second is served from it
+                for (int i = 0; i < 2; i++) {
+                    FeeCalculation cached;
+                    FeeCalculation computed;
+                    BOOST_CHECK(estimateSmartFee(target, &cached, conservative) == estimateSmartFeeLocked(target, &computed, conservative));
+                    BOOST_CHECK(cached.reason == computed.reason);
+                    BOOST_CHECK_EQUAL(cached.desiredTarget, computed.desiredTarget);
+                    BOOST_CHECK_EQUAL(cached.returnedTarget, computed.returnedTarget);
+                }
+            }
+        }
+    }
+};
+
 BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
 {
-    CBlockPolicyEstimator feeEst;
+    CBlockPolicyEstimatorTest feeEst;
     CTxMemPool mpool(&feeEst);
     TestMemPoolEntryHelper entry;
     CAmount basefee(2000);
@@ -83,8 +109,10 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
             BOOST_CHECK(feeEst.estimateFee(1) == CFeeRate(0));
             BOOST_CHECK(feeEst.estimateFee(2).GetFeePerK() < 9*baseRate.GetFeePerK() + deltaFee);
             BOOST_CHECK(feeEst.estimateFee(2).GetFeePerK() > 9*baseRate.GetFeePerK() - deltaFee);
+            feeEst.CheckSmartFeeTable();
         }
     }
+    feeEst.CheckSmartFeeTable();
 
     std::vector<CAmount> origFeeEst;
     // Highest feerate is 10*baseRate and gets in all blocks,
@@ -113,6 +141,7 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     // We haven't decayed the moving average enough so we still have enough data points in every bucket
     while (blocknum < 250)
         mpool.removeForBlock(block, ++blocknum);
+    feeEst.CheckSmartFeeTable();
 
     BOOST_CHECK(feeEst.estimateFee(1) == CFeeRate(0));
     for (int i = 2; i < 10;i++) {
@@ -134,6 +163,7 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
         }
         mpool.removeForBlock(block, ++blocknum);
     }
+    feeEst.CheckSmartFeeTable();
 
     for (int i = 1; i < 10;i++) {
         BOOST_CHECK(feeEst.estimateFee(i) == CFeeRate(0) || feeEst.estimateFee(i).GetFeePerK() > origFeeEst[i-1] - deltaFee);
@@ -151,6 +181,7 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
     mpool.removeForBlock(block, 266);
     block.clear();
+    feeEst.CheckSmartFeeTable();
     BOOST_CHECK(feeEst.estimateFee(1) == CFeeRate(0));
     for (int i = 2; i < 10;i++) {
         BOOST_CHECK(feeEst.estimateFee(i) == CFeeRate(0) || feeEst.estimateFee(i).GetFeePerK() > origFeeEst[i-1] - deltaFee);
@@ -177,6 +208,20 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     for (int i = 2; i < 9; i++) { // At 9, the original estimate was already at the bottom (b/c scale = 2)
         BOOST_CHECK(feeEst.estimateFee(i).GetFeePerK() < origFeeEst[i-1] - deltaFee);
     }
+    feeEst.CheckSmartFeeTable();
+
+    // Estimates read back from disk are cached the same way
+    CAutoFile file(tmpfile(), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    BOOST_CHECK(feeEst.Write(file));
+    rewind(file.Get());
+    CBlockPolicyEstimatorTest feeEstRead;
+    BOOST_CHECK(feeEstRead.Read(file));
+    feeEstRead.CheckSmartFeeTable();
+    for (int i = 1; i <= 48; i++) {
+        BOOST_CHECK(feeEstRead.estimateSmartFee(i, nullptr, false) == feeEst.estimateSmartFee(i, nullptr, false));
+        BOOST_CHECK(feeEstRead.estimateSmartFee(i, nullptr, true) == feeEst.estimateSmartFee(i, nullptr, true));
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <miner.h>
 #include <pow.h>
 #include <random.h>
 #include <util.h>
@@ -83,4 +84,52 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(CpuMiner_threads)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    Consensus::Params params = chainParams->GetConsensus();
+    params.powLimit = uint256S("7fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+
+    CBlockHeader header;
+    header.nVersion = 4;
+    header.hashPrevBlock = uint256S("01");
+    header.hashMerkleRoot = uint256S("02");
+    header.nTime = 1600000000;
+    // Around 256 hashes per block, enough for the workers to take part
+    header.nBits = 0x20010000;
+    header.nNonce = 0;
+
+    CBlockHeader single = header;
+    uint64_t nTriesSingle = 1000000;
+    BOOST_CHECK(CpuMiner(1).Mine(single, 0x10000, nTriesSingle, params));
+    BOOST_CHECK(CheckProofOfWork(single.GetPoWHash(), single.nBits, params));
+    BOOST_CHECK_EQUAL(nTriesSingle, 1000000 - single.nNonce);
+
+    // More threads find the same, lowest nonce
+    CpuMiner miner(4);
+    for (int i = 0; i < 3; i++) {
+        CBlockHeader multi = header;
+        uint64_t nTries = 1000000;
+        BOOST_CHECK(miner.Mine(multi, 0x10000, nTries, params));
+        BOOST_CHECK_EQUAL(multi.nNonce, single.nNonce);
+        BOOST_CHECK_EQUAL(nTries, nTriesSingle);
+    }
+
+    // Running out of tries just before it
+    CBlockHeader multi = header;
+    uint64_t nTries = single.nNonce;
+    BOOST_CHECK(!miner.Mine(multi, 0x10000, nTries, params));
+    BOOST_CHECK_EQUAL(multi.nNonce, single.nNonce);
+    BOOST_CHECK_EQUAL(nTries, 0U);
+
+    // No hash satisfies a target above the limit
+    multi = header;
+    multi.nBits = 0x207fffff;
+    params.powLimit = uint256S("00ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    nTries = 100;
+    BOOST_CHECK(!miner.Mine(multi, 0x10000, nTries, params));
+    BOOST_CHECK_EQUAL(multi.nNonce, 100U);
+    BOOST_CHECK_EQUAL(nTries, 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
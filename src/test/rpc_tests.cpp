@@ -8,6 +8,7 @@
 #include <base58.h>
 #include <core_io.h>
 #include <netbase.h>
+#include <primitives/transaction.h>
 
 #include <test/test_bitcoin.h>
 
@@ -143,6 +144,39 @@ BOOST_AUTO_TEST_CASE(rpc_createraw_op_return)
     BOOST_CHECK_NO_THROW(CallRPC("createrawtransaction [{\"txid\":\"a3b807410df0b60fcb9736768df5823938b2f838694939ba45f3c0a1bff150ed\",\"vout\":0}] {\"data\":\"010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081\"}"));
 }
 
+BOOST_AUTO_TEST_CASE(rpc_sendrawtransactions)
+{
+    const COutPoint funding = AddTestCoin(COIN);
+    const CMutableTransaction parent = CreateTestSpend({funding}, COIN - 10000);
+    const CMutableTransaction child = CreateTestSpend({COutPoint(parent.GetHash(), 0)}, COIN - 20000);
+    const CMutableTransaction doublespend = CreateTestSpend({funding}, COIN - 20000);
+
+    BOOST_CHECK_THROW(CallRPC("sendrawtransactions"), std::runtime_error);
+    BOOST_CHECK_THROW(CallRPC("sendrawtransactions [\"DEADBEEF\"]"), std::runtime_error);
+
+    // Batches are limited to 1000 transactions, checked before decoding any
+    std::string strTooMany = "sendrawtransactions [\"00\"";
+    for (int i = 0; i < 1000; i++)
+        strTooMany += ",\"00\"";
+    BOOST_CHECK_THROW(CallRPC(strTooMany + "]"), std::runtime_error);
+
+    // The child comes before its parent, and the double spend after both
+    UniValue r = CallRPC("sendrawtransactions [\"" + EncodeHexTx(child) + "\",\"" + EncodeHexTx(parent) + "\",\"" + EncodeHexTx(doublespend) + "\"]");
+    BOOST_REQUIRE_EQUAL(r.size(), 3U);
+    BOOST_CHECK_EQUAL(find_value(r[0], "txid").get_str(), child.GetHash().GetHex());
+    BOOST_CHECK(find_value(r[0], "accepted").get_bool());
+    BOOST_CHECK(find_value(r[0], "error").isNull());
+    BOOST_CHECK_EQUAL(find_value(r[1], "txid").get_str(), parent.GetHash().GetHex());
+    BOOST_CHECK(find_value(r[1], "accepted").get_bool());
+    BOOST_CHECK_EQUAL(find_value(r[2], "txid").get_str(), doublespend.GetHash().GetHex());
+    BOOST_CHECK(!find_value(r[2], "accepted").get_bool());
+    BOOST_CHECK_EQUAL(find_value(r[2], "error").get_str(), "18: txn-mempool-conflict");
+
+    // Resubmitting transactions already in the mempool accepts them again
+    r = CallRPC("sendrawtransactions [\"" + EncodeHexTx(parent) + "\"]");
+    BOOST_CHECK(find_value(r[0], "accepted").get_bool());
+}
+
 BOOST_AUTO_TEST_CASE(rpc_format_monetary_values)
 {
     BOOST_CHECK(ValueFromAmount(0LL).write() == "0.00000000");
@@ -32,4 +32,50 @@ BOOST_AUTO_TEST_CASE(scrypt_hashtest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scrypt_multi)
+{
+    // The multi-buffer kernels must agree with hashing one input at a time,
+    // including for batches that are not a multiple of the lane count.
+#if defined(USE_SSE2)
+    (void) scrypt_detect_sse2();
+#endif
+    const size_t count = 13;
+    std::vector<char> input(count * 80);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = (char)(i * 7 + 3);
+    std::vector<char> output(count * 32);
+    scrypt_1024_1_1_256_multi(&input[0], &output[0], count);
+    for (size_t i = 0; i < count; i++) {
+        uint256 single, multi;
+        scrypt_1024_1_1_256(&input[i * 80], BEGIN(single));
+        memcpy(BEGIN(multi), &output[i * 32], 32);
+        BOOST_CHECK_EQUAL(multi.ToString(), single.ToString());
+    }
+
+#if defined(USE_SSE2)
+    char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
+    std::vector<char> scratchpad_multi(SCRYPT_MULTI_SCRATCHPAD_SIZE);
+    for (size_t i = 0; i < count * 32; i++)
+        output[i] = 0;
+    scrypt_1024_1_1_256_sp_sse2_4way(&input[0], &output[0], &scratchpad_multi[0]);
+    for (size_t i = 0; i < 4; i++) {
+        uint256 single, multi;
+        scrypt_1024_1_1_256_sp_generic(&input[i * 80], BEGIN(single), scratchpad);
+        memcpy(BEGIN(multi), &output[i * 32], 32);
+        BOOST_CHECK_EQUAL(multi.ToString(), single.ToString());
+    }
+#if defined(USE_SCRYPT_AVX2)
+    if (scrypt_avx2_detected) {
+        scrypt_1024_1_1_256_sp_avx2_8way(&input[0], &output[0], &scratchpad_multi[0]);
+        for (size_t i = 0; i < 8; i++) {
+            uint256 single, multi;
+            scrypt_1024_1_1_256_sp_generic(&input[i * 80], BEGIN(single), scratchpad);
+            memcpy(BEGIN(multi), &output[i * 32], 32);
+            BOOST_CHECK_EQUAL(multi.ToString(), single.ToString());
+        }
+    }
+#endif
+#endif
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,17 +5,21 @@
 #include <test/test_bitcoin.h>
 
 #include <chainparams.h>
+#include <clientversion.h>
 #include <consensus/consensus.h>
+#include <consensus/merkle.h>
 #include <consensus/validation.h>
 #include <crypto/sha256.h>
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
+#include <pow.h>
 #include <ui_interface.h>
 #include <streams.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <script/sigcache.h>
+#include <script/standard.h>
 
 #include <memory>
 
@@ -189,3 +193,72 @@ CBlock getBlock13b8a()
     stream >> block;
     return block;
 }
+
+CBlock CreateTestBlock(const uint256& hashPrevBlock, int nHeight, uint32_t nTime, const std::vector<CTransactionRef>& txns)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = hashPrevBlock;
+    block.nTime = nTime;
+    block.nBits = 0x1e0ffff0;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    coinbase.vout[0].nValue = 50 * COIN;
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.insert(block.vtx.end(), txns.begin(), txns.end());
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+std::vector<CBlock> CreateTestChain()
+{
+    static const uint32_t nonces[] = {0x0012a0a6, 0x00051ae9, 0x000282d5};
+    const CBlock& genesis = Params().GenesisBlock();
+    std::vector<CBlock> chain;
+    uint256 hashPrev = genesis.GetHash();
+    for (int nHeight = 1; nHeight <= 3; nHeight++) {
+        CBlock block = CreateTestBlock(hashPrev, nHeight, genesis.nTime + 150 * nHeight);
+        block.nNonce = nonces[nHeight - 1];
+        assert(CheckProofOfWork(block.GetPoWHash(), block.nBits, Params().GetConsensus()));
+        hashPrev = block.GetHash();
+        chain.push_back(block);
+    }
+    return chain;
+}
+
+CDiskBlockPos AppendTestBlock(const CBlock& block)
+{
+    fs::create_directories(GetDataDir() / "blocks");
+    CAutoFile fileout(fsbridge::fopen(GetBlockPosFilename(CDiskBlockPos(0, 0), "blk"), "ab"), SER_DISK, CLIENT_VERSION);
+    assert(!fileout.IsNull());
+    fileout << FLATDATA(Params().MessageStart()) << (unsigned int)GetSerializeSize(fileout, block);
+    CDiskBlockPos pos(0, ftell(fileout.Get()));
+    fileout << block;
+    return pos;
+}
+
+static const CScript TRUE_REDEEM_SCRIPT = CScript() << OP_TRUE;
+
+COutPoint AddTestCoin(const CAmount& nValue)
+{
+    LOCK(cs_main);
+    COutPoint outpoint(InsecureRand256(), 0);
+    pcoinsTip->AddCoin(outpoint, Coin(CTxOut(nValue, GetScriptForDestination(CScriptID(TRUE_REDEEM_SCRIPT))), 1, false), false);
+    return outpoint;
+}
+
+CMutableTransaction CreateTestSpend(const std::vector<COutPoint>& vPrevouts, const CAmount& nValue)
+{
+    CMutableTransaction tx;
+    for (const COutPoint& prevout : vPrevouts) {
+        tx.vin.emplace_back(prevout);
+        tx.vin.back().scriptSig = CScript() << ToByteVector(TRUE_REDEEM_SCRIPT);
+    }
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    tx.vout[0].scriptPubKey = GetScriptForDestination(CScriptID(TRUE_REDEEM_SCRIPT));
+    return tx;
+}
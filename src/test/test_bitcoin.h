@@ -120,6 +120,33 @@ struct TestMemPoolEntryHelper
 
 CBlock getBlock13b8a();
 
+struct CDiskBlockPos;
+
+/**
+ * Create a block on hashPrevBlock with a coinbase for nHeight paying 50
+ * coins to OP_TRUE, followed by txns. The header is not mined.
+ */
+CBlock CreateTestBlock(const uint256& hashPrevBlock, int nHeight, uint32_t nTime, const std::vector<CTransactionRef>& txns = std::vector<CTransactionRef>());
+
+/**
+ * Blocks 1 to 3 on the main chain genesis block, made by CreateTestBlock
+ * 150 seconds apart, with nonces found offline as scrypt is too slow to mine
+ * them at the minimum difficulty in a test.
+ */
+std::vector<CBlock> CreateTestChain();
+
+/** Append a block to block file 0 the way WriteBlockToDisk does, and return its position */
+CDiskBlockPos AppendTestBlock(const CBlock& block);
+
+/** Add a coin confirmed at height 1 to pcoinsTip, paying nValue to P2SH(OP_TRUE), and return its outpoint */
+COutPoint AddTestCoin(const CAmount& nValue);
+
+/**
+ * Create a transaction spending vPrevouts, which must pay to P2SH(OP_TRUE),
+ * with standard scriptSigs, and paying nValue back to P2SH(OP_TRUE).
+ */
+CMutableTransaction CreateTestSpend(const std::vector<COutPoint>& vPrevouts, const CAmount& nValue);
+
 // define an implicit conversion here so that uint256 may be used directly in BOOST_CHECK_*
 std::ostream& operator<<(std::ostream& os, const uint256& num);
 
@@ -58,4 +58,59 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+/**
+ * Ensure that a batch is accepted in any order, and that each of its
+ * transactions gets its own validation state.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_batch, TestingSetup)
+{
+    const COutPoint funding1 = AddTestCoin(COIN);
+    const COutPoint funding2 = AddTestCoin(COIN);
+
+    const CMutableTransaction parent = CreateTestSpend({funding1}, COIN - 10000);
+    const CMutableTransaction child = CreateTestSpend({COutPoint(parent.GetHash(), 0)}, COIN - 20000);
+    const CMutableTransaction spend = CreateTestSpend({funding2}, COIN - 10000);
+    const CMutableTransaction doublespend = CreateTestSpend({funding2}, COIN - 20000);
+    const CMutableTransaction orphan = CreateTestSpend({COutPoint(InsecureRand256(), 0)}, COIN);
+    CMutableTransaction coinbase = CreateTestSpend({COutPoint()}, COIN);
+    coinbase.vin[0].scriptSig = CScript() << OP_11 << OP_EQUAL;
+    BOOST_REQUIRE(CTransaction(coinbase).IsCoinBase());
+
+    // The child comes before its parent
+    const std::vector<CTransactionRef> vtx = {
+        MakeTransactionRef(child), MakeTransactionRef(parent), MakeTransactionRef(spend),
+        MakeTransactionRef(doublespend), MakeTransactionRef(orphan), MakeTransactionRef(coinbase)};
+    std::vector<CValidationState> vState;
+    std::vector<bool> vMissingInputs;
+    BOOST_CHECK(!AcceptToMemoryPoolBatch(mempool, vtx, vState, vMissingInputs, nullptr /* plTxnReplaced */, 0 /* nAbsurdFee */));
+    BOOST_REQUIRE_EQUAL(vState.size(), vtx.size());
+    BOOST_REQUIRE_EQUAL(vMissingInputs.size(), vtx.size());
+
+    LOCK(cs_main);
+    for (size_t i = 0; i < 3; i++) {
+        BOOST_CHECK(mempool.exists(vtx[i]->GetHash()));
+        BOOST_CHECK(vState[i].IsValid());
+        BOOST_CHECK(!vMissingInputs[i]);
+    }
+    BOOST_CHECK_EQUAL(mempool.size(), 3U);
+
+    // The second spend of funding2 conflicts with the first one of the batch
+    BOOST_CHECK(vState[3].IsInvalid());
+    BOOST_CHECK_EQUAL(vState[3].GetRejectReason(), "txn-mempool-conflict");
+    BOOST_CHECK(!vMissingInputs[3]);
+
+    // Nothing in the batch creates the input of the orphan
+    BOOST_CHECK(vState[4].IsValid());
+    BOOST_CHECK(vMissingInputs[4]);
+
+    BOOST_CHECK(vState[5].IsInvalid());
+    BOOST_CHECK_EQUAL(vState[5].GetRejectReason(), "coinbase");
+    BOOST_CHECK(!vMissingInputs[5]);
+
+    // A batch that is accepted in full returns true
+    const CMutableTransaction grandchild = CreateTestSpend({COutPoint(child.GetHash(), 0)}, COIN - 30000);
+    BOOST_CHECK(AcceptToMemoryPoolBatch(mempool, {MakeTransactionRef(grandchild)}, vState, vMissingInputs, nullptr /* plTxnReplaced */, 0 /* nAbsurdFee */));
+    BOOST_CHECK(mempool.exists(grandchild.GetHash()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -368,4 +368,73 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     }
 }
 
+/** Count the script flags a transaction is in the script execution cache for, and check both transactions agree on each */
+static unsigned int CountCachedFlags(const CTransaction& tx1, const CTransaction& tx2)
+{
+    PrecomputedTransactionData txdata1(tx1);
+    PrecomputedTransactionData txdata2(tx2);
+    unsigned int nCached = 0;
+    for (uint32_t test_flags = 0; test_flags < (1U << 16); test_flags++) {
+        CValidationState state;
+        std::vector<CScriptCheck> scriptchecks1;
+        std::vector<CScriptCheck> scriptchecks2;
+        BOOST_CHECK(CheckInputs(tx1, state, pcoinsTip.get(), true, test_flags, true, false, txdata1, &scriptchecks1));
+        BOOST_CHECK(CheckInputs(tx2, state, pcoinsTip.get(), true, test_flags, true, false, txdata2, &scriptchecks2));
+        BOOST_CHECK_EQUAL(scriptchecks1.empty(), scriptchecks2.empty());
+        if (scriptchecks1.empty())
+            nCached++;
+    }
+    return nCached;
+}
+
+BOOST_FIXTURE_TEST_CASE(checkinputs_parallel_test, TestingSetup)
+{
+    // Transactions with many inputs have their scripts checked on the script
+    // check threads when they go into the mempool. Make sure this gives the
+    // same result, and caches the same entries, as checking them serially.
+    BOOST_REQUIRE(nScriptCheckThreads > 1);
+    const unsigned int nInputs = DEFAULT_MEMPOOL_PARALLEL_INPUTS + 8;
+    std::vector<CMutableTransaction> spends;
+    for (int i = 0; i < 4; i++) {
+        std::vector<COutPoint> prevouts;
+        for (unsigned int n = 0; n < nInputs; n++) {
+            prevouts.push_back(AddTestCoin(COIN));
+        }
+        spends.push_back(CreateTestSpend(prevouts, nInputs * COIN - 100000));
+    }
+    // Invalidate an input in the middle of the last two
+    for (int i = 2; i < 4; i++) {
+        spends[i].vin[nInputs / 2].scriptSig = CScript() << ToByteVector(CScript() << OP_FALSE);
+    }
+
+    std::vector<CValidationState> states(spends.size());
+    for (size_t i = 0; i < spends.size(); i++) {
+        // Even transactions take the parallel path, odd ones the serial one
+        nMempoolParallelInputs = i % 2 ? 0 : DEFAULT_MEMPOOL_PARALLEL_INPUTS;
+        LOCK(cs_main);
+        AcceptToMemoryPool(mempool, states[i], MakeTransactionRef(spends[i]), nullptr /* pfMissingInputs */,
+                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */);
+    }
+    nMempoolParallelInputs = DEFAULT_MEMPOOL_PARALLEL_INPUTS;
+
+    LOCK(cs_main);
+    BOOST_CHECK(states[0].IsValid());
+    BOOST_CHECK(states[1].IsValid());
+    BOOST_CHECK(mempool.exists(spends[0].GetHash()));
+    BOOST_CHECK(mempool.exists(spends[1].GetHash()));
+
+    BOOST_CHECK(states[2].IsInvalid());
+    BOOST_CHECK(states[3].IsInvalid());
+    BOOST_CHECK_EQUAL(states[2].GetRejectCode(), states[3].GetRejectCode());
+    BOOST_CHECK_EQUAL(states[2].GetRejectReason(), states[3].GetRejectReason());
+    BOOST_CHECK_EQUAL(states[2].GetDebugMessage(), states[3].GetDebugMessage());
+    BOOST_CHECK(!mempool.exists(spends[2].GetHash()));
+    BOOST_CHECK(!mempool.exists(spends[3].GetHash()));
+
+    // Accepted transactions are cached for the flags of the next block only
+    BOOST_CHECK_EQUAL(CountCachedFlags(spends[0], spends[1]), 1U);
+    // Rejected ones aren't cached at all
+    BOOST_CHECK_EQUAL(CountCachedFlags(spends[2], spends[3]), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -15,6 +15,8 @@
 #include <validation.h>
 #include <init.h>
 
+#include <map>
+#include <set>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -24,6 +26,7 @@ static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_POW_HASH = 'w';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -33,6 +36,7 @@ static const char DB_LAST_BLOCK = 'l';
 
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSSUMMARY = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_BLOCKHASHINDEX = 'z';
 static const char DB_SPENTINDEX = 'p';
@@ -61,7 +65,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true), nWrites(0)
 {
 }
 
@@ -89,6 +93,8 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    // The count is odd while the write is under way, see GetWriteCount
+    nWrites++;
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -145,6 +151,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
+    nWrites++;
     LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return ret;
 }
@@ -239,6 +246,8 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        if (!(*it)->hashPoW.IsNull())
+            batch.Write(std::make_pair(DB_BLOCK_POW_HASH, (*it)->GetBlockHash()), (*it)->hashPoW);
     }
     return WriteBatch(batch, true);
 }
@@ -270,6 +279,55 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
+    // Load the scrypt hashes recorded for accepted headers first, so they can
+    // be compared against below. They are written in the same batch as their
+    // index entry, so every key has a matching entry.
+    pcursor->Seek(std::make_pair(DB_BLOCK_POW_HASH, uint256()));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (pcursor->GetKey(key) && key.first == DB_BLOCK_POW_HASH) {
+            uint256 hashPoW;
+            if (!pcursor->GetValue(hashPoW))
+                return error("%s: failed to read PoW hash", __func__);
+            insertBlockIndex(key.second)->hashPoW = hashPoW;
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    // Beyondcoin: Recomputing every scrypt hash at startup takes several minutes,
+    // so by default we trust the data on the local disk. With -checkblockindexpow
+    // the headers are streamed in batches to the header PoW check threads instead,
+    // which also fills in the hashes missing from the table above.
+    const size_t nCheckBatchSize = 4096;
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<CBlockIndex*> vIndex;
+    size_t nChecked = 0;
+    int64_t nStart = GetTimeMillis();
+    auto check_pow = [&]() {
+        std::vector<uint256> vHashes;
+        CheckHeadersPoW(vHeaders, vHashes, consensusParams);
+        CDBBatch batch(*this);
+        for (size_t i = 0; i < vHeaders.size(); i++) {
+            if (vHashes[i].IsNull())
+                vHashes[i] = vHeaders[i].GetPoWHash();
+            if (!CheckProofOfWork(vHashes[i], vHeaders[i].nBits, consensusParams))
+                return error("%s: CheckProofOfWork failed: %s", __func__, vIndex[i]->ToString());
+            if (vIndex[i]->hashPoW.IsNull()) {
+                vIndex[i]->hashPoW = vHashes[i];
+                batch.Write(std::make_pair(DB_BLOCK_POW_HASH, vIndex[i]->GetBlockHash()), vHashes[i]);
+            } else if (vIndex[i]->hashPoW != vHashes[i]) {
+                return error("%s: recorded PoW hash does not match header: %s", __func__, vIndex[i]->ToString());
+            }
+        }
+        nChecked += vHeaders.size();
+        vHeaders.clear();
+        vIndex.clear();
+        return WriteBatch(batch);
+    };
+
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
     // Load mapBlockIndex
@@ -294,14 +352,20 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
-                // Beyondcoin: Disable PoW Sanity check while loading block index from disk.
-                // We use the sha256 hash for the block index for performance reasons, which is recorded for later use.
-                // CheckProofOfWork() uses the scrypt hash which is discarded after a block is accepted.
-                // While it is technically feasible to verify the PoW, doing so takes several minutes as it
-                // requires recomputing every PoW hash during every Beyondcoin startup.
-                // We opt instead to simply trust the data that is on your local disk.
-                //if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
-                //    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                // The genesis block's PoW is not checked when it is accepted either.
+                if (fCheckBlockIndexPoW && pindexNew->GetBlockHash() != consensusParams.hashGenesisBlock) {
+                    CBlockHeader header;
+                    header.nVersion       = diskindex.nVersion;
+                    header.hashPrevBlock  = diskindex.hashPrev;
+                    header.hashMerkleRoot = diskindex.hashMerkleRoot;
+                    header.nTime          = diskindex.nTime;
+                    header.nBits          = diskindex.nBits;
+                    header.nNonce         = diskindex.nNonce;
+                    vHeaders.push_back(header);
+                    vIndex.push_back(pindexNew);
+                    if (vHeaders.size() >= nCheckBatchSize && !check_pow())
+                        return false;
+                }
 
                 pcursor->Next();
             } else {
@@ -312,6 +376,12 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
         }
     }
 
+    if (fCheckBlockIndexPoW) {
+        if (!check_pow())
+            return false;
+        LogPrintf("%s: checked proof of work of %u block headers in %dms\n", __func__, nChecked, GetTimeMillis() - nStart);
+    }
+
     return true;
 }
 
@@ -468,18 +538,36 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ReadAddressUnspentIndex(addressHash, type, nullptr,
+        [&unspentOutputs](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+            unspentOutputs.push_back(std::make_pair(key, value));
+            return true;
+        });
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type, const CAddressUnspentKey* pAfter,
+                                           const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pAfter) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, *pAfter));
+    } else {
+        pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.type == (unsigned int)type && key.second.hashBytes == addressHash) {
+            if (pAfter && key.second == *pAfter) {
+                pcursor->Next();
+                continue;
+            }
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(std::make_pair(key.second, nValue));
+                if (!fn(key.second, nValue))
+                    break;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -492,10 +580,65 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
+namespace {
+
+/** Per-address totals of a set of address index deltas. */
+struct CAddressSummaryDelta {
+    CAmount balance = 0;
+    CAmount received = 0;
+    CAmount sent = 0;
+    std::set<uint256> txids;
+    int minHeight = std::numeric_limits<int>::max();
+    int maxHeight = -1;
+};
+
+typedef std::map<std::pair<unsigned int, uint160>, CAddressSummaryDelta> AddressSummaryDeltaMap;
+
+AddressSummaryDeltaMap SummarizeAddressDeltas(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    AddressSummaryDeltaMap deltas;
+    for (const auto& entry : vect) {
+        CAddressSummaryDelta& delta = deltas[std::make_pair(entry.first.type, entry.first.hashBytes)];
+        delta.balance += entry.second;
+        if (entry.second > 0) {
+            delta.received += entry.second;
+        } else {
+            delta.sent -= entry.second;
+        }
+        delta.txids.insert(entry.first.txhash);
+        delta.minHeight = std::min(delta.minHeight, entry.first.blockHeight);
+        delta.maxHeight = std::max(delta.maxHeight, entry.first.blockHeight);
+    }
+    return deltas;
+}
+
+} // namespace
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+
+    for (const auto& entry : SummarizeAddressDeltas(vect)) {
+        const CAddressIndexIteratorKey key(entry.first.first, entry.first.second);
+        const CAddressSummaryDelta& delta = entry.second;
+        CAddressSummaryValue summary;
+        if (!ReadAddressSummary(key.hashBytes, key.type, summary))
+            return false;
+        // The deltas themselves are rewritten idempotently when a block is
+        // connected again after an unclean shutdown; skip the totals too.
+        if (summary.lastHeight >= delta.minHeight)
+            continue;
+        if (summary.IsNull()) {
+            summary.firstHeight = delta.minHeight;
+        }
+        summary.balance += delta.balance;
+        summary.received += delta.received;
+        summary.sent += delta.sent;
+        summary.txCount += delta.txids.size();
+        summary.lastHeight = std::max(summary.lastHeight, delta.maxHeight);
+        batch.Write(std::make_pair(DB_ADDRESSSUMMARY, key), summary);
+    }
     return WriteBatch(batch);
 }
 
@@ -503,16 +646,134 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+
+    for (const auto& entry : SummarizeAddressDeltas(vect)) {
+        const CAddressIndexIteratorKey key(entry.first.first, entry.first.second);
+        const CAddressSummaryDelta& delta = entry.second;
+        CAddressSummaryValue summary;
+        if (!ReadAddressSummary(key.hashBytes, key.type, summary))
+            return false;
+        // Already taken out by an earlier attempt at disconnecting this block
+        if (summary.lastHeight < delta.maxHeight)
+            continue;
+        if (summary.txCount <= delta.txids.size()) {
+            batch.Erase(std::make_pair(DB_ADDRESSSUMMARY, key));
+            continue;
+        }
+        summary.balance -= delta.balance;
+        summary.received -= delta.received;
+        summary.sent -= delta.sent;
+        summary.txCount -= delta.txids.size();
+
+        // Blocks are only disconnected from the tip, so the new last height
+        // is that of the newest delta below the ones being erased.
+        std::unique_ptr<CDBIterator> pcursor(NewIterator());
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(key.type, key.hashBytes, delta.minHeight)));
+        if (pcursor->Valid())
+            pcursor->Prev();
+        std::pair<char, CAddressIndexKey> prevKey;
+        if (!pcursor->Valid() || !pcursor->GetKey(prevKey) || prevKey.first != DB_ADDRESSINDEX ||
+            prevKey.second.type != key.type || prevKey.second.hashBytes != key.hashBytes) {
+            return error("%s: no address index entries below height %d", __func__, delta.minHeight);
+        }
+        summary.lastHeight = prevKey.second.blockHeight;
+        batch.Write(std::make_pair(DB_ADDRESSSUMMARY, key), summary);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary) {
+    summary.SetNull();
+    const auto key = std::make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(type, addressHash));
+    if (!Exists(key))
+        return true;
+    if (!Read(key, summary))
+        return error("failed to read address summary");
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressSummaries() {
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    size_t nSummaries = 0;
+
+    pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey()));
+
+    // Entries are ordered by address and then by height and position in the
+    // block, so each address's history is a contiguous run and a transaction
+    // touching it shows up as consecutive entries.
+    CAddressIndexIteratorKey current;
+    CAddressSummaryValue summary;
+    uint256 lastTxid;
+    auto flush_summary = [&]() {
+        if (summary.IsNull())
+            return;
+        batch.Write(std::make_pair(DB_ADDRESSSUMMARY, current), summary);
+        nSummaries++;
+        summary.SetNull();
+    };
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested()) return false;
+        std::pair<char, CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
+            break;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+
+        if (key.second.type != current.type || key.second.hashBytes != current.hashBytes) {
+            flush_summary();
+            current = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+            lastTxid.SetNull();
+            if (batch.SizeEstimate() > (size_t)nDefaultDbBatchSize) {
+                if (!WriteBatch(batch))
+                    return false;
+                batch.Clear();
+            }
+        }
+
+        if (summary.IsNull()) {
+            summary.firstHeight = key.second.blockHeight;
+        }
+        summary.balance += nValue;
+        if (nValue > 0) {
+            summary.received += nValue;
+        } else {
+            summary.sent -= nValue;
+        }
+        if (key.second.txhash != lastTxid) {
+            summary.txCount++;
+            lastTxid = key.second.txhash;
+        }
+        summary.lastHeight = key.second.blockHeight;
+        pcursor->Next();
+    }
+    flush_summary();
+
+    LogPrintf("%s: wrote %u address summaries\n", __func__, nSummaries);
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
+    return ReadAddressIndex(addressHash, type, nullptr, start, end,
+        [&addressIndex](const CAddressIndexKey& key, CAmount value) {
+            addressIndex.push_back(std::make_pair(key, value));
+            return true;
+        });
+}
+
+bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pAfter, int start, int end,
+                                    const std::function<bool(const CAddressIndexKey&, CAmount)>& fn) {
 
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pAfter) {
+        pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, *pAfter));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
@@ -521,13 +782,18 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.type == (unsigned int)type && key.second.hashBytes == addressHash) {
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            if (pAfter && key.second == *pAfter) {
+                pcursor->Next();
+                continue;
+            }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(std::make_pair(key.second, nValue));
+                if (!fn(key.second, nValue))
+                    break;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -14,6 +14,8 @@
 #include <index/spentindex.h>
 #include <index/timestampindex.h>
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -73,6 +75,8 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! Twice the number of BatchWrite calls so far, plus one while one is under way
+    std::atomic<uint64_t> nWrites;
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -86,6 +90,12 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+    /**
+     * A count that goes up when a write to the coins starts and again when
+     * it is done, so it is odd while a write is under way. Coins read while
+     * the count stays the same, and even, are still what the database holds.
+     */
+    uint64_t GetWriteCount() const { return nWrites; }
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -135,11 +145,20 @@ public:
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    /** Stream unspent outputs in key order, resuming after pAfter if given, until fn returns false. */
+    bool ReadAddressUnspentIndex(uint160 addressHash, int type, const CAddressUnspentKey* pAfter,
+                                 const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /** Stream deltas in key order, resuming after pAfter if given, until fn returns false. */
+    bool ReadAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pAfter, int start, int end,
+                          const std::function<bool(const CAddressIndexKey&, CAmount)>& fn);
+    bool ReadAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary);
+    /** Rebuild the per-address summaries from the address index deltas. */
+    bool BuildAddressSummaries();
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
@@ -18,6 +18,33 @@
 #include <utilmoneystr.h>
 #include <utiltime.h>
 
+#include <algorithm>
+
+const CAmount FEE_HISTOGRAM_LIMITS[FEE_HISTOGRAM_BUCKETS] = {
+    0, 1000, 2000, 3000, 4000, 5000, 6000, 8000, 10000, 15000, 20000, 30000, 50000, 100000, 200000, 500000
+};
+
+static int GetFeeHistogramBucket(CAmount nFee, size_t nSize)
+{
+    CAmount nFeeRate = CFeeRate(nFee, nSize).GetFeePerK();
+    int bucket = std::upper_bound(FEE_HISTOGRAM_LIMITS, FEE_HISTOGRAM_LIMITS + FEE_HISTOGRAM_BUCKETS, nFeeRate) - FEE_HISTOGRAM_LIMITS - 1;
+    // Negative fee deltas can push a feerate below the first bucket
+    return std::max(bucket, 0);
+}
+
+static void UpdateFeeHistogramBucket(FeeHistogramBucket& bucket, const CTxMemPoolEntry& entry, bool add)
+{
+    if (add) {
+        bucket.nCount++;
+        bucket.nSize += entry.GetTxSize();
+        bucket.nFees += entry.GetModifiedFee();
+    } else {
+        bucket.nCount--;
+        bucket.nSize -= entry.GetTxSize();
+        bucket.nFees -= entry.GetModifiedFee();
+    }
+}
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
                                  bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp):
@@ -37,6 +64,9 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
     nSizeWithAncestors = GetTxSize();
     nModFeesWithAncestors = nFee;
     nSigOpCostWithAncestors = sigOpCost;
+
+    nClusterId = 0;
+    nClusterIdx = 0;
 }
 
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
@@ -95,7 +125,9 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
             modifyCount++;
             cachedDescendants[updateIt].insert(cit);
             // Update ancestor state for each descendant
+            UpdateAncestorFeeHistogram(*cit, false);
             mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
+            UpdateAncestorFeeHistogram(*cit, true);
         }
     }
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
@@ -143,6 +175,7 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
             if (setChildren.insert(childIter).second && !setAlreadyIncluded.count(childHash)) {
                 UpdateChild(it, childIter, true);
                 UpdateParent(childIter, it, true);
+                MergeClusters(it, childIter);
             }
         }
         UpdateForDescendants(it, mapMemPoolDescendantsToUpdate, setAlreadyIncluded);
@@ -252,6 +285,19 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 
 void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants)
 {
+    // Entries removed along with their whole cluster have no ancestors,
+    // descendants or links left behind that would need updating
+    std::map<uint64_t, uint64_t> mapRemovedFromCluster;
+    for (txiter removeIt : entriesToRemove) {
+        mapRemovedFromCluster[removeIt->nClusterId]++;
+    }
+    std::vector<txiter> vToUpdate;
+    for (txiter removeIt : entriesToRemove) {
+        if (mapRemovedFromCluster[removeIt->nClusterId] < GetCluster(removeIt).members.size()) {
+            vToUpdate.push_back(removeIt);
+        }
+    }
+
     // For each entry, walk back all ancestors and decrement size associated with this
     // transaction
     const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -262,7 +308,7 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // Here we only update statistics and not data in mapLinks (which
         // we need to preserve until we're finished with all operations that
         // need to traverse the mempool).
-        for (txiter removeIt : entriesToRemove) {
+        for (txiter removeIt : vToUpdate) {
             setEntries setDescendants;
             CalculateDescendants(removeIt, setDescendants);
             setDescendants.erase(removeIt); // don't update state for self
@@ -270,11 +316,13 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
             CAmount modifyFee = -removeIt->GetModifiedFee();
             int modifySigOps = -removeIt->GetSigOpCost();
             for (txiter dit : setDescendants) {
+                UpdateAncestorFeeHistogram(*dit, false);
                 mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, -1, modifySigOps));
+                UpdateAncestorFeeHistogram(*dit, true);
             }
         }
     }
-    for (txiter removeIt : entriesToRemove) {
+    for (txiter removeIt : vToUpdate) {
         setEntries setAncestors;
         const CTxMemPoolEntry &entry = *removeIt;
         std::string dummy;
@@ -303,7 +351,7 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
     // After updating all the ancestor sizes, we can now sever the link between each
     // transaction being removed and any mempool children (ie, update setMemPoolParents
     // for each direct child of a transaction being removed).
-    for (txiter removeIt : entriesToRemove) {
+    for (txiter removeIt : vToUpdate) {
         UpdateChildrenForRemoval(removeIt);
     }
 }
@@ -382,6 +430,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // (When we update the entry for in-mempool parents, memory usage will be
     // further updated.)
     cachedInnerUsage += entry.DynamicMemoryUsage();
+    AddToNewCluster(newit);
 
     const CTransaction& tx = newit->GetTx();
     std::set<uint256> setParentTransactions;
@@ -401,10 +450,12 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         txiter pit = mapTx.find(phash);
         if (pit != mapTx.end()) {
             UpdateParent(newit, pit, true);
+            MergeClusters(newit, pit);
         }
     }
     UpdateAncestorsOf(true, newit, setAncestors);
     UpdateEntryForAncestors(newit, setAncestors);
+    UpdateFeeHistograms(*newit, true);
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
@@ -433,38 +484,42 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         vTxHashes.clear();
 
     totalTxSize -= it->GetTxSize();
+    UpdateFeeHistograms(*it, false);
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
+    removeAddressIndex(hash);
+    removeSpentIndex(it->GetTx());
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
-    removeAddressIndex(hash);
-    removeSpentIndex(hash);
 }
 
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<CMempoolAddressKey> inserted;
 
     uint256 txhash = tx.GetHash();
+    auto add_delta = [&](int type, const uint160& addressHash, unsigned int index, int spending, const CMempoolAddressDelta& delta) {
+        CMempoolAddressKey key(type, addressHash);
+        addressDeltaList& list = mapAddress[key];
+        cachedIndexUsage -= memusage::DynamicUsage(list);
+        list.push_back(CMempoolAddressDeltaEntry(txhash, index, spending, delta));
+        cachedIndexUsage += memusage::DynamicUsage(list);
+        inserted.push_back(key);
+    };
+
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
         const CTxIn input = tx.vin[j];
         const CTxOut &prevout = view.AccessCoin(input.prevout).out;
         if (prevout.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            add_delta(2, uint160(hashBytes), j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n));
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            add_delta(1, uint160(hashBytes), j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n));
         }
     }
 
@@ -472,19 +527,21 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         const CTxOut &out = tx.vout[k];
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            add_delta(2, uint160(hashBytes), k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            add_delta(1, uint160(hashBytes), k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    if (inserted.empty())
+        return;
+
+    std::sort(inserted.begin(), inserted.end());
+    inserted.erase(std::unique(inserted.begin(), inserted.end()), inserted.end());
+    inserted.shrink_to_fit();
+    cachedIndexUsage += memusage::DynamicUsage(inserted);
+    mapAddressInserted.emplace(txhash, std::move(inserted));
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
@@ -492,10 +549,11 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+        addressDeltaMap::const_iterator ait = mapAddress.find(CMempoolAddressKey((*it).second, (*it).first));
+        if (ait == mapAddress.end())
+            continue;
+        for (const CMempoolAddressDeltaEntry& delta : ait->second) {
+            results.push_back(std::make_pair(CMempoolAddressDeltaKey((*it).second, (*it).first, delta.txhash, delta.index, delta.spending), delta.delta));
         }
     }
     return true;
@@ -507,10 +565,27 @@ bool CTxMemPool::removeAddressIndex(const uint256 txhash)
     addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
 
     if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+        for (const CMempoolAddressKey& key : it->second) {
+            addressDeltaMap::iterator ait = mapAddress.find(key);
+            if (ait == mapAddress.end())
+                continue;
+            addressDeltaList& list = ait->second;
+            cachedIndexUsage -= memusage::DynamicUsage(list);
+            for (size_t i = 0; i < list.size(); ) {
+                if (list[i].txhash == txhash) {
+                    list[i] = list.back();
+                    list.pop_back();
+                } else {
+                    i++;
+                }
+            }
+            if (list.empty()) {
+                mapAddress.erase(ait);
+            } else {
+                cachedIndexUsage += memusage::DynamicUsage(list);
+            }
         }
+        cachedIndexUsage -= memusage::DynamicUsage(it->second);
         mapAddressInserted.erase(it);
     }
 
@@ -522,7 +597,6 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
     LOCK(cs);
 
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -542,15 +616,10 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
             addressType = 0;
         }
 
-        CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
-        inserted.push_back(key);
-
+        mapSpent.insert(std::make_pair(input.prevout, value));
     }
-
-    mapSpentInserted.insert(std::make_pair(txhash, inserted));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -558,7 +627,7 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     LOCK(cs);
     mapSpentIndex::iterator it;
 
-    it = mapSpent.find(key);
+    it = mapSpent.find(COutPoint(key.txid, key.outputIndex));
     if (it != mapSpent.end()) {
         value = it->second;
         return true;
@@ -566,17 +635,18 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return false;
 }
 
-bool CTxMemPool::removeSpentIndex(const uint256 txhash)
+bool CTxMemPool::removeSpentIndex(const CTransaction& tx)
 {
     LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
+    if (mapSpent.empty())
+        return true;
 
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
+    const uint256 txhash = tx.GetHash();
+    for (const CTxIn& input : tx.vin) {
+        mapSpentIndex::iterator it = mapSpent.find(input.prevout);
+        if (it != mapSpent.end() && it->second.txid == txhash) {
+            mapSpent.erase(it);
         }
-        mapSpentInserted.erase(it);
     }
 
     return true;
@@ -590,6 +660,16 @@ bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
+    // When everything in the cluster descends from entryit there are no
+    // links to walk
+    if (setDescendants.empty()) {
+        const TxCluster& cluster = GetCluster(entryit);
+        if (entryit->GetCountWithDescendants() == cluster.members.size()) {
+            setDescendants.insert(cluster.members.begin(), cluster.members.end());
+            return;
+        }
+    }
+
     setEntries stage;
     if (setDescendants.count(entryit) == 0) {
         stage.insert(entryit);
@@ -714,17 +794,23 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    // A block can take many transactions out of the same cluster, which is
+    // split once they are all gone rather than after each of them
+    std::set<uint64_t> setSplitClusters;
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
         if (it != mapTx.end()) {
             setEntries stage;
             stage.insert(it);
-            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+            RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK, &setSplitClusters);
         }
         removeConflicts(*tx);
         ClearPrioritisation(tx->GetHash());
     }
+    for (uint64_t id : setSplitClusters) {
+        SplitCluster(id);
+    }
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
 }
@@ -732,10 +818,18 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 void CTxMemPool::_clear()
 {
     mapLinks.clear();
+    mapClusters.clear();
+    nNextClusterId = 1;
     mapTx.clear();
     mapNextTx.clear();
+    mapAddress.clear();
+    mapAddressInserted.clear();
+    mapSpent.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    cachedIndexUsage = 0;
+    feeHistogram.fill(FeeHistogramBucket());
+    ancestorFeeHistogram.fill(FeeHistogramBucket());
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -843,6 +937,13 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             }
         }
         assert(setChildrenCheck == GetMemPoolChildren(it));
+        // Linked transactions share a cluster
+        for (txiter linkit : setParentCheck) {
+            assert(linkit->nClusterId == it->nClusterId);
+        }
+        for (txiter linkit : setChildrenCheck) {
+            assert(linkit->nClusterId == it->nClusterId);
+        }
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         assert(it->GetSizeWithDescendants() >= childSizes + it->GetTxSize());
@@ -875,6 +976,58 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(&tx == it->second);
     }
 
+    // Check that every transaction is in exactly one cluster, that each
+    // cluster is connected and that its totals add up
+    uint64_t nClusterMembers = 0;
+    for (const auto& cluster : mapClusters) {
+        const std::vector<txiter>& members = cluster.second.members;
+        assert(!members.empty());
+        innerUsage += memusage::DynamicUsage(members);
+        uint64_t nSizeCheck = 0;
+        CAmount nFeesCheck = 0;
+        for (size_t i = 0; i < members.size(); i++) {
+            assert(members[i]->nClusterId == cluster.first);
+            assert(members[i]->nClusterIdx == i);
+            nSizeCheck += members[i]->GetTxSize();
+            nFeesCheck += members[i]->GetModifiedFee();
+        }
+        assert(cluster.second.nSize == nSizeCheck);
+        assert(cluster.second.nModFees == nFeesCheck);
+
+        setEntries setReached;
+        std::vector<txiter> stage{members[0]};
+        setReached.insert(members[0]);
+        while (!stage.empty()) {
+            txiter reachedit = stage.back();
+            stage.pop_back();
+            for (const setEntries* links : {&GetMemPoolParents(reachedit), &GetMemPoolChildren(reachedit)}) {
+                for (txiter linkit : *links) {
+                    if (setReached.insert(linkit).second)
+                        stage.push_back(linkit);
+                }
+            }
+        }
+        assert(setReached.size() == members.size());
+        nClusterMembers += members.size();
+    }
+    assert(nClusterMembers == mapTx.size());
+
+    FeeHistogram feeHistogramCheck, ancestorFeeHistogramCheck;
+    feeHistogramCheck.fill(FeeHistogramBucket());
+    ancestorFeeHistogramCheck.fill(FeeHistogramBucket());
+    for (const CTxMemPoolEntry& entry : mapTx) {
+        UpdateFeeHistogramBucket(feeHistogramCheck[GetFeeHistogramBucket(entry.GetModifiedFee(), entry.GetTxSize())], entry, true);
+        UpdateFeeHistogramBucket(ancestorFeeHistogramCheck[GetFeeHistogramBucket(entry.GetModFeesWithAncestors(), entry.GetSizeWithAncestors())], entry, true);
+    }
+    for (int i = 0; i < FEE_HISTOGRAM_BUCKETS; i++) {
+        assert(feeHistogram[i].nCount == feeHistogramCheck[i].nCount);
+        assert(feeHistogram[i].nSize == feeHistogramCheck[i].nSize);
+        assert(feeHistogram[i].nFees == feeHistogramCheck[i].nFees);
+        assert(ancestorFeeHistogram[i].nCount == ancestorFeeHistogramCheck[i].nCount);
+        assert(ancestorFeeHistogram[i].nSize == ancestorFeeHistogramCheck[i].nSize);
+        assert(ancestorFeeHistogram[i].nFees == ancestorFeeHistogramCheck[i].nFees);
+    }
+
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
 }
@@ -981,7 +1134,12 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         delta += nFeeDelta;
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
+            UpdateFeeHistograms(*it, false);
             mapTx.modify(it, update_fee_delta(delta));
+            UpdateFeeHistograms(*it, true);
+            clusterMap::iterator clusterit = mapClusters.find(it->nClusterId);
+            assert(clusterit != mapClusters.end());
+            clusterit->second.nModFees += nFeeDelta;
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -995,7 +1153,9 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             CalculateDescendants(it, setDescendants);
             setDescendants.erase(it);
             for (txiter descendantIt : setDescendants) {
+                UpdateAncestorFeeHistogram(*descendantIt, false);
                 mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
+                UpdateAncestorFeeHistogram(*descendantIt, true);
             }
             ++nTransactionsUpdated;
         }
@@ -1048,15 +1208,38 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(mapClusters) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage +
+        memusage::DynamicUsage(mapAddress) + memusage::DynamicUsage(mapAddressInserted) + memusage::DynamicUsage(mapSpent) + cachedIndexUsage;
 }
 
-void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
+void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason, std::set<uint64_t>* pSplitClusters) {
     AssertLockHeld(cs);
+    // Count the links between removed and remaining members of each cluster.
+    // Remaining members can only lose their connection to each other if
+    // there was more than one such link.
+    std::map<uint64_t, int> mapClusterLinks;
+    for (txiter it : stage) {
+        int& nLinks = mapClusterLinks[it->nClusterId];
+        for (const setEntries* links : {&GetMemPoolParents(it), &GetMemPoolChildren(it)}) {
+            for (txiter linkit : *links) {
+                if (!stage.count(linkit))
+                    nLinks++;
+            }
+        }
+    }
     UpdateForRemoveFromMempool(stage, updateDescendants);
     for (const txiter& it : stage) {
+        RemoveFromCluster(it);
         removeUnchecked(it, reason);
     }
+    for (const auto& cluster : mapClusterLinks) {
+        if (cluster.second <= 1)
+            continue;
+        if (pSplitClusters)
+            pSplitClusters->insert(cluster.first);
+        else
+            SplitCluster(cluster.first);
+    }
 }
 
 int CTxMemPool::Expire(int64_t time) {
@@ -1121,6 +1304,116 @@ const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) cons
     return it->second.children;
 }
 
+const CTxMemPool::TxCluster & CTxMemPool::GetCluster(txiter entry) const
+{
+    clusterMap::const_iterator it = mapClusters.find(entry->nClusterId);
+    assert(it != mapClusters.end());
+    return it->second;
+}
+
+void CTxMemPool::GetClusterState(const CTxMemPoolEntry& entry, uint64_t& nCount, uint64_t& nSize, CAmount& nModFees) const
+{
+    AssertLockHeld(cs);
+    const TxCluster& cluster = GetCluster(mapTx.iterator_to(entry));
+    nCount = cluster.members.size();
+    nSize = cluster.nSize;
+    nModFees = cluster.nModFees;
+}
+
+void CTxMemPool::AddToNewCluster(txiter entry)
+{
+    const uint64_t id = nNextClusterId++;
+    TxCluster& cluster = mapClusters.emplace_hint(mapClusters.end(), id, TxCluster())->second;
+    cluster.members.push_back(entry);
+    cluster.nSize = entry->GetTxSize();
+    cluster.nModFees = entry->GetModifiedFee();
+    entry->nClusterId = id;
+    entry->nClusterIdx = 0;
+    cachedInnerUsage += memusage::DynamicUsage(cluster.members);
+}
+
+void CTxMemPool::MergeClusters(txiter a, txiter b)
+{
+    if (a->nClusterId == b->nClusterId)
+        return;
+    clusterMap::iterator ita = mapClusters.find(a->nClusterId);
+    clusterMap::iterator itb = mapClusters.find(b->nClusterId);
+    assert(ita != mapClusters.end() && itb != mapClusters.end());
+    // Move the members of the smaller cluster, so that each transaction
+    // only moves a logarithmic number of times
+    if (ita->second.members.size() < itb->second.members.size())
+        std::swap(ita, itb);
+    TxCluster& into = ita->second;
+    TxCluster& from = itb->second;
+    cachedInnerUsage -= memusage::DynamicUsage(into.members) + memusage::DynamicUsage(from.members);
+    for (txiter member : from.members) {
+        member->nClusterId = ita->first;
+        member->nClusterIdx = into.members.size();
+        into.members.push_back(member);
+    }
+    into.nSize += from.nSize;
+    into.nModFees += from.nModFees;
+    cachedInnerUsage += memusage::DynamicUsage(into.members);
+    mapClusters.erase(itb);
+}
+
+void CTxMemPool::RemoveFromCluster(txiter entry)
+{
+    clusterMap::iterator it = mapClusters.find(entry->nClusterId);
+    assert(it != mapClusters.end());
+    TxCluster& cluster = it->second;
+    assert(cluster.members[entry->nClusterIdx] == entry);
+    cachedInnerUsage -= memusage::DynamicUsage(cluster.members);
+    if (cluster.members.size() == 1) {
+        mapClusters.erase(it);
+        return;
+    }
+    cluster.members[entry->nClusterIdx] = cluster.members.back();
+    cluster.members[entry->nClusterIdx]->nClusterIdx = entry->nClusterIdx;
+    cluster.members.pop_back();
+    cluster.nSize -= entry->GetTxSize();
+    cluster.nModFees -= entry->GetModifiedFee();
+    cachedInnerUsage += memusage::DynamicUsage(cluster.members);
+}
+
+void CTxMemPool::SplitCluster(uint64_t id)
+{
+    clusterMap::iterator it = mapClusters.find(id);
+    if (it == mapClusters.end())
+        return;
+    std::vector<txiter> members = std::move(it->second.members);
+    cachedInnerUsage -= memusage::DynamicUsage(members);
+    mapClusters.erase(it);
+
+    for (txiter member : members) {
+        member->nClusterId = 0;
+    }
+    for (txiter root : members) {
+        if (root->nClusterId != 0)
+            continue;
+        const uint64_t newId = nNextClusterId++;
+        TxCluster& cluster = mapClusters.emplace_hint(mapClusters.end(), newId, TxCluster())->second;
+        root->nClusterId = newId;
+        cluster.members.push_back(root);
+        // The member list doubles as the queue of a breadth-first search
+        for (size_t i = 0; i < cluster.members.size(); i++) {
+            txiter member = cluster.members[i];
+            member->nClusterIdx = i;
+            cluster.nSize += member->GetTxSize();
+            cluster.nModFees += member->GetModifiedFee();
+            for (const setEntries* links : {&GetMemPoolParents(member), &GetMemPoolChildren(member)}) {
+                for (txiter linkit : *links) {
+                    if (linkit->nClusterId == 0) {
+                        linkit->nClusterId = newId;
+                        cluster.members.push_back(linkit);
+                    }
+                }
+            }
+        }
+        cachedInnerUsage += memusage::DynamicUsage(cluster.members);
+    }
+}
+
 CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
     LOCK(cs);
     if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
@@ -1203,4 +1496,24 @@ bool CTxMemPool::TransactionWithinChainLimit(const uint256& txid, size_t chainLi
        it->GetCountWithDescendants() < chainLimit);
 }
 
+void CTxMemPool::UpdateFeeHistograms(const CTxMemPoolEntry& entry, bool add)
+{
+    UpdateFeeHistogramBucket(feeHistogram[GetFeeHistogramBucket(entry.GetModifiedFee(), entry.GetTxSize())], entry, add);
+    UpdateAncestorFeeHistogram(entry, add);
+}
+
+void CTxMemPool::UpdateAncestorFeeHistogram(const CTxMemPoolEntry& entry, bool add)
+{
+    UpdateFeeHistogramBucket(ancestorFeeHistogram[GetFeeHistogramBucket(entry.GetModFeesWithAncestors(), entry.GetSizeWithAncestors())], entry, add);
+}
+
+void CTxMemPool::GetFeeHistograms(FeeHistogram& modified, FeeHistogram& ancestor) const
+{
+    LOCK(cs);
+    modified = feeHistogram;
+    ancestor = ancestorFeeHistogram;
+}
+
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -6,9 +6,11 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <array>
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -17,6 +19,7 @@
 #include <coins.h>
 #include <indirectmap.h>
 #include <policy/feerate.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
 #include <sync.h>
 #include <random.h>
@@ -131,6 +134,8 @@ public:
     int64_t GetSigOpCostWithAncestors() const { return nSigOpCostWithAncestors; }
 
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
+    mutable uint64_t nClusterId; //!< Key of the mempool cluster this entry belongs to
+    mutable size_t nClusterIdx;  //!< Index in the members of that cluster
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -338,6 +343,21 @@ struct TxMempoolInfo
     int64_t nFeeDelta;
 };
 
+/** Number of buckets of the mempool feerate histograms */
+static const int FEE_HISTOGRAM_BUCKETS = 16;
+/** Lower bound of each feerate histogram bucket, in satoshis per 1000 virtual bytes */
+extern const CAmount FEE_HISTOGRAM_LIMITS[FEE_HISTOGRAM_BUCKETS];
+
+/** Mempool transactions whose feerate falls into one histogram bucket */
+struct FeeHistogramBucket
+{
+    uint64_t nCount;
+    uint64_t nSize;   //!< sum of virtual sizes
+    CAmount nFees;    //!< sum of modified fees
+};
+
+typedef std::array<FeeHistogramBucket, FEE_HISTOGRAM_BUCKETS> FeeHistogram;
+
 /** Reason why a transaction was removed from the mempool,
  * this is passed to the notification signal.
  */
@@ -365,6 +385,20 @@ public:
     }
 };
 
+class SaltedAddressHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const CMempoolAddressKey& key) const {
+        return CSipHasher(k0, k1).Write(key.type).Write(key.addressBytes.begin(), key.addressBytes.size()).Finalize();
+    }
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -435,6 +469,22 @@ public:
  * CalculateMemPoolAncestors() takes configurable limits that are designed to
  * prevent these calculations from being too CPU intensive.
  *
+ * Clusters:
+ *
+ * Transactions connected through mapLinks, directly or indirectly, form a
+ * cluster, for which we keep the list of members and their total size and
+ * fees. Adding a link merges two clusters; removing transactions splits a
+ * cluster again when they were the only connection between its remaining
+ * members. Whenever a transaction's descendants or ancestors make up its
+ * whole cluster, they can be taken from the member list instead of walking
+ * the links, and transactions removed together with their whole cluster
+ * need no ancestor or descendant state updates at all. This keeps eviction
+ * of long chains linear in the size of the chain. A cluster that has come
+ * apart still does all of this correctly, as its members are a superset of
+ * each piece, so removeForBlock() splits clusters only once the whole block
+ * is out of the mempool, keeping the cost of a block that takes many
+ * transactions out of one cluster linear in the size of that cluster.
+ *
  */
 class CTxMemPool
 {
@@ -508,21 +558,60 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
+    struct TxCluster {
+        std::vector<txiter> members;
+        uint64_t nSize;    //!< sum of the members' virtual sizes
+        CAmount nModFees;  //!< ... and modified fees
+
+        TxCluster() : nSize(0), nModFees(0) {}
+    };
+
+    typedef std::map<uint64_t, TxCluster> clusterMap;
+    clusterMap mapClusters;
+    uint64_t nNextClusterId;
+
+    /**
+     * Mempool deltas of each address. Most addresses only have one or two
+     * deltas in the mempool, so the first one is stored inline in the map node.
+     */
+    typedef prevector<1, CMempoolAddressDeltaEntry> addressDeltaList;
+    typedef std::unordered_map<CMempoolAddressKey, addressDeltaList, SaltedAddressHasher> addressDeltaMap;
     addressDeltaMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    //! Distinct addresses touched by each transaction, so they can be found again on removal
+    typedef std::unordered_map<uint256, std::vector<CMempoolAddressKey>, SaltedTxidHasher> addressDeltaMapInserted;
     addressDeltaMapInserted mapAddressInserted;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    //! Spending input of each outpoint spent in the mempool. Entries are found again on removal through the inputs of the transaction.
+    typedef std::unordered_map<COutPoint, CSpentIndexValue, SaltedOutpointHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
+    //! Heap usage of the delta lists in mapAddress and the vectors in mapAddressInserted
+    uint64_t cachedIndexUsage;
+
+    //! Transactions by modified feerate
+    FeeHistogram feeHistogram;
+    //! Transactions by the modified feerate of their package with ancestors
+    FeeHistogram ancestorFeeHistogram;
+
+    /** Add an entry to or remove it from both histograms */
+    void UpdateFeeHistograms(const CTxMemPoolEntry& entry, bool add);
+    /** Add an entry to or remove it from the ancestor feerate histogram, around changes of its ancestor state */
+    void UpdateAncestorFeeHistogram(const CTxMemPoolEntry& entry, bool add);
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    const TxCluster& GetCluster(txiter entry) const;
+    /** Put an entry without links into a cluster of its own */
+    void AddToNewCluster(txiter entry);
+    /** Merge the clusters of two entries that have just been linked */
+    void MergeClusters(txiter a, txiter b);
+    /** Take an entry that is about to be removed out of its cluster */
+    void RemoveFromCluster(txiter entry);
+    /** Replace a cluster by the connected components of its members */
+    void SplitCluster(uint64_t id);
+
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const;
 
 public:
@@ -559,7 +648,7 @@ public:
 
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool removeSpentIndex(const uint256 txhash);
+    bool removeSpentIndex(const CTransaction& tx);
 
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
     void removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags);
@@ -591,8 +680,10 @@ public:
      *  in a block.
      *  Set updateDescendants to true when removing a tx that was in a block, so
      *  that any in-mempool descendants have their ancestor state updated.
+     *  If pSplitClusters is given, clusters that may have come apart are
+     *  added to it for the caller to split, instead of being split here.
      */
-    void RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
+    void RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN, std::set<uint64_t>* pSplitClusters = nullptr);
 
     /** When adding transactions from a disconnected block back to the mempool,
      *  new mempool entries may have children in the mempool (which is generally
@@ -642,6 +733,12 @@ public:
     /** Returns false if the transaction is in the mempool and not within the chain limit specified. */
     bool TransactionWithinChainLimit(const uint256& txid, size_t chainLimit) const;
 
+    /** Current feerate histograms, by modified feerate and by ancestor feerate */
+    void GetFeeHistograms(FeeHistogram& modified, FeeHistogram& ancestor) const;
+
+    /** Number of transactions, total size and total modified fees of the cluster of an entry. Requires cs. */
+    void GetClusterState(const CTxMemPoolEntry& entry, uint64_t& nCount, uint64_t& nSize, CAmount& nModFees) const;
+
     unsigned long size()
     {
         LOCK(cs);
@@ -6,6 +6,8 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockfilereader.h>
+#include <blockprefetcher.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -17,6 +19,7 @@
 #include <cuckoocache.h>
 #include <hash.h>
 #include <init.h>
+#include <mempooljournal.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -28,7 +31,6 @@
 #include <script/script.h>
 #include <script/sigcache.h>
 #include <script/standard.h>
-#include <stats/stats.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -41,8 +43,13 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <future>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -161,8 +168,8 @@ public:
 
     bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock);
 
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex);
-    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashPoW = nullptr);
+    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phashPoW = nullptr);
 
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
@@ -213,6 +220,7 @@ CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 uint256 hashBestBlock;
 int nScriptCheckThreads = 0;
+unsigned int nMempoolParallelInputs = DEFAULT_MEMPOOL_PARALLEL_INPUTS;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fTxIndex = false;
@@ -224,6 +232,7 @@ bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
+bool fCheckBlockIndexPoW = DEFAULT_CHECKBLOCKINDEXPOW;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
@@ -551,9 +560,17 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
+static bool CheckInputsParallel(const CTransaction& tx, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata);
+
+/**
+ * Validate a transaction and add it to the mempool. With fBatch set the
+ * caller is adding several transactions under one lock: trimming the
+ * mempool, the TransactionAddedToMempool signal and the stats sample are
+ * left to it, so they run once for the whole batch.
+ */
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache)
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache, bool fBatch)
 {
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
@@ -641,7 +658,6 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         }
     }
 
-    CFeeRate poolMinFeeRate;
     {
         CCoinsView dummy;
         CCoinsViewCache view(&dummy);
@@ -728,8 +744,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
                 strprintf("%d", nSigOpsCost));
 
-        poolMinFeeRate = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
-        CAmount mempoolRejectFee = poolMinFeeRate.GetFee(nSize);
+        CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
         if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nFees, mempoolRejectFee));
         }
@@ -906,7 +921,17 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+        bool fScriptsOk;
+        if (nScriptCheckThreads && nMempoolParallelInputs && tx.vin.size() >= nMempoolParallelInputs) {
+            // Spread the scripts of large transactions over the script check
+            // threads. Failures are rare, so they are simply rechecked serially
+            // below to find out why.
+            fScriptsOk = CheckInputsParallel(tx, view, scriptVerifyFlags, txdata) ||
+                CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata);
+        } else {
+            fScriptsOk = CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata);
+        }
+        if (!fScriptsOk) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
@@ -987,17 +1012,17 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         }
 
         // trim mempool and check if tx was trimmed
-        if (!bypass_limits) {
+        if (!bypass_limits && !fBatch) {
             LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
             if (!pool.exists(hash))
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
         }
     }
 
-    GetMainSignals().TransactionAddedToMempool(ptx);
+    if (fBatch)
+        return true;
 
-    // Update mempool stats cache
-    CStats::DefaultStats()->addMempoolSample(pool.size(), pool.DynamicMemoryUsage(), poolMinFeeRate.GetFeePerK());
+    GetMainSignals().TransactionAddedToMempool(ptx);
 
     return true;
 }
@@ -1008,7 +1033,7 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
                         bool bypass_limits, const CAmount nAbsurdFee)
 {
     std::vector<COutPoint> coins_to_uncache;
-    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache);
+    bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, coins_to_uncache, false);
     if (!res) {
         for (const COutPoint& hashTx : coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
@@ -1027,6 +1052,72 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee);
 }
 
+/** (try to) add a batch of transactions to memory pool, each with its own acceptance time **/
+static bool AcceptToMemoryPoolBatchWithTime(const CChainParams& chainparams, CTxMemPool& pool, const std::vector<CTransactionRef>& vtx,
+                             const std::vector<int64_t>& vAcceptTime, std::vector<CValidationState>& vState,
+                             std::vector<bool>& vMissingInputs, std::list<CTransactionRef>* plTxnReplaced, const CAmount nAbsurdFee)
+{
+    assert(vAcceptTime.size() == vtx.size());
+    vState.assign(vtx.size(), CValidationState());
+    vMissingInputs.assign(vtx.size(), false);
+    std::vector<bool> vAccepted(vtx.size(), false);
+    std::vector<std::vector<COutPoint> > vCoinsToUncache(vtx.size());
+
+    LOCK(cs_main);
+    {
+        LOCK(pool.cs);
+
+        // Children may come before their parents in the batch, so transactions
+        // with missing inputs are retried for as long as others get accepted.
+        bool fProgress = true;
+        for (bool fFirstPass = true; fProgress; fFirstPass = false) {
+            fProgress = false;
+            for (size_t i = 0; i < vtx.size(); i++) {
+                if (vAccepted[i] || (!fFirstPass && !vMissingInputs[i]))
+                    continue;
+                CValidationState state;
+                bool fMissingInputs = false;
+                std::vector<COutPoint> coins_to_uncache;
+                if (AcceptToMemoryPoolWorker(chainparams, pool, state, vtx[i], &fMissingInputs, vAcceptTime[i], plTxnReplaced, false, nAbsurdFee, coins_to_uncache, true)) {
+                    vAccepted[i] = true;
+                    vCoinsToUncache[i] = std::move(coins_to_uncache);
+                    fProgress = true;
+                } else {
+                    for (const COutPoint& outpoint : coins_to_uncache)
+                        pcoinsTip->Uncache(outpoint);
+                }
+                vState[i] = state;
+                vMissingInputs[i] = fMissingInputs;
+            }
+        }
+
+        LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+        for (size_t i = 0; i < vtx.size(); i++) {
+            if (!vAccepted[i])
+                continue;
+            if (!pool.exists(vtx[i]->GetHash())) {
+                vAccepted[i] = false;
+                vState[i].DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+                for (const COutPoint& outpoint : vCoinsToUncache[i])
+                    pcoinsTip->Uncache(outpoint);
+                continue;
+            }
+            GetMainSignals().TransactionAddedToMempool(vtx[i]);
+        }
+    }
+
+    CValidationState stateDummy;
+    FlushStateToDisk(chainparams, stateDummy, FLUSH_STATE_PERIODIC);
+    return std::find(vAccepted.begin(), vAccepted.end(), false) == vAccepted.end();
+}
+
+bool AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx, std::vector<CValidationState>& vState,
+                             std::vector<bool>& vMissingInputs, std::list<CTransactionRef>* plTxnReplaced, const CAmount nAbsurdFee)
+{
+    const CChainParams& chainparams = Params();
+    return AcceptToMemoryPoolBatchWithTime(chainparams, pool, vtx, std::vector<int64_t>(vtx.size(), GetTime()), vState, vMissingInputs, plTxnReplaced, nAbsurdFee);
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes)
 {
     if (!fTimestampIndex)
@@ -1075,6 +1166,41 @@ bool GetAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pAfter, int start, int end,
+                     const std::function<bool(const CAddressIndexKey&, CAmount)>& fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressIndex(addressHash, type, pAfter, start, end, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspent(uint160 addressHash, int type, const CAddressUnspentKey* pAfter,
+                       const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, pAfter, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressSummary(addressHash, type, summary))
+        return error("unable to get summary for address");
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
@@ -1181,43 +1307,83 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CRawBlock raw;
+    if (!g_block_file_reader.Read(pos, raw))
+        return error("ReadBlockFromDisk: Reading block file failed for %s", pos.ToString());
 
     // Read block
     try {
-        filein >> block;
+        CSpanReader(SER_DISK, CLIENT_VERSION, raw.begin(), raw.end()) >> block;
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    return ReadBlockFromDisk(block, pos, consensusParams, true);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
+    uint256 hashPoW;
     {
         LOCK(cs_main);
         blockPos = pindex->GetBlockPos();
+        hashPoW = pindex->hashPoW;
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    // Once the scrypt hash of a header is known there is no need to recompute
+    // it: matching GetHash() against the index ties the block to that header.
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, false))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+
+    if (hashPoW.IsNull()) {
+        hashPoW = block.GetPoWHash();
+        if (CheckProofOfWork(hashPoW, block.nBits, consensusParams)) {
+            // Remember it so later reads of this block can skip the scrypt hash.
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(pindex->GetBlockHash());
+            if (mi != mapBlockIndex.end() && mi->second->hashPoW.IsNull()) {
+                mi->second->hashPoW = hashPoW;
+                setDirtyBlockIndex.insert(mi->second);
+            }
+        }
+    }
+    if (!CheckProofOfWork(hashPoW, block.nBits, consensusParams))
+        return error("ReadBlockFromDisk: Errors in block header at %s", blockPos.ToString());
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CRawBlock& raw, const CBlockIndex* pindex)
+{
+    CDiskBlockPos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+
+    if (!g_block_file_reader.Read(blockPos, raw))
+        return error("ReadRawBlockFromDisk: Reading block file failed for %s", blockPos.ToString());
+    // As in ReadBlockFromDisk, matching the header against the index is enough
+    if (raw.size() < 80 || Hash(raw.begin(), raw.begin() + 80) != pindex->GetBlockHash())
+        return error("ReadRawBlockFromDisk: GetHash() doesn't match index for %s at %s",
+                pindex->ToString(), blockPos.ToString());
     return true;
 }
 
@@ -1812,8 +1978,11 @@ void static FlushBlockFile(bool fFinalize = false)
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+            // A mapping of the preallocated space past the new end must not be read from
+            g_block_file_reader.Forget(nLastBlockFile);
+        }
         FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1875,6 +2044,146 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Verify the scripts of a mempool transaction on the script check threads.
+ * Returns false if any input fails, without saying which; the caller is
+ * expected to run CheckInputs serially in that case to fill in the state.
+ */
+static bool CheckInputsParallel(const CTransaction& tx, const CCoinsViewCache& view, unsigned int flags, PrecomputedTransactionData& txdata)
+{
+    AssertLockHeld(cs_main);
+    std::vector<CScriptCheck> vChecks;
+    CValidationState stateDummy;
+    if (!CheckInputs(tx, stateDummy, view, true, flags, true, false, txdata, &vChecks))
+        return false;
+
+    // cs_main is held, so ConnectBlock cannot be using the queue at the same time
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
+/**
+ * Warm the caches for accepting a group of transactions read from disk. Their
+ * inputs are loaded into pcoinsTip in outpoint order, so the coins database
+ * is read front to back, and the scripts of transactions spending only
+ * confirmed coins are verified on the script check threads. Nothing is
+ * accepted here; the signatures found valid are simply in the signature
+ * cache when the transactions go through AcceptToMemoryPool. The inputs that
+ * were not cached before are added to coins_to_uncache, so that those of
+ * transactions that are then rejected can be uncached again.
+ */
+static void PrefetchMempoolInputs(const std::vector<CTransactionRef>& vtx, std::vector<COutPoint>& coins_to_uncache)
+{
+    AssertLockHeld(cs_main);
+    std::vector<COutPoint> vOutPoints;
+    for (const CTransactionRef& tx : vtx) {
+        for (const CTxIn& txin : tx->vin) {
+            vOutPoints.push_back(txin.prevout);
+        }
+    }
+    std::sort(vOutPoints.begin(), vOutPoints.end());
+    vOutPoints.erase(std::unique(vOutPoints.begin(), vOutPoints.end()), vOutPoints.end());
+    for (const COutPoint& outpoint : vOutPoints) {
+        if (!pcoinsTip->HaveCoinInCache(outpoint))
+            coins_to_uncache.push_back(outpoint);
+        pcoinsTip->HaveCoin(outpoint);
+    }
+
+    if (!nScriptCheckThreads)
+        return;
+
+    // CScriptCheck keeps a pointer to its PrecomputedTransactionData
+    std::vector<PrecomputedTransactionData> vTxData;
+    vTxData.reserve(vtx.size());
+    std::vector<CScriptCheck> vChecks;
+    CValidationState stateDummy;
+    for (const CTransactionRef& tx : vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        bool fConfirmedInputs = true;
+        for (const CTxIn& txin : tx->vin) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                fConfirmedInputs = false;
+                break;
+            }
+        }
+        if (!fConfirmedInputs)
+            continue;
+        vTxData.emplace_back(*tx);
+        CheckInputs(*tx, stateDummy, *pcoinsTip, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, vTxData.back(), &vChecks);
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+/**
+ * Closure computing the scrypt hashes of a run of consecutive headers and
+ * checking them against the headers' own nBits. This is the context-free part
+ * of header validation, done before ProcessNewBlockHeaders takes cs_main.
+ */
+class CHeaderPoWCheck
+{
+private:
+    const CBlockHeader* pheaders;
+    size_t nCount;
+    uint256* phashes;
+    const Consensus::Params* pconsensusParams;
+
+public:
+    CHeaderPoWCheck(): pheaders(nullptr), nCount(0), phashes(nullptr), pconsensusParams(nullptr) {}
+    CHeaderPoWCheck(const CBlockHeader* pheadersIn, size_t nCountIn, uint256* phashesIn, const Consensus::Params& consensusParams) :
+        pheaders(pheadersIn), nCount(nCountIn), phashes(phashesIn), pconsensusParams(&consensusParams) {}
+
+    bool operator()() {
+        GetPoWHashes(pheaders, nCount, phashes);
+        for (size_t i = 0; i < nCount; i++) {
+            if (!CheckProofOfWork(phashes[i], pheaders[i].nBits, *pconsensusParams))
+                return false;
+        }
+        return true;
+    }
+
+    void swap(CHeaderPoWCheck& check) {
+        std::swap(pheaders, check.pheaders);
+        std::swap(nCount, check.nCount);
+        std::swap(phashes, check.phashes);
+        std::swap(pconsensusParams, check.pconsensusParams);
+    }
+};
+
+static CCheckQueue<CHeaderPoWCheck> headerpowcheckqueue(1);
+
+void ThreadHeaderPoWCheck() {
+    RenameThread("beyondcoin-headerpow");
+    headerpowcheckqueue.Thread();
+}
+
+bool CheckHeadersPoW(const std::vector<CBlockHeader>& headers, std::vector<uint256>& hashes, const Consensus::Params& consensusParams)
+{
+    hashes.assign(headers.size(), uint256());
+    std::vector<CHeaderPoWCheck> vChecks;
+    for (size_t i = 0; i < headers.size(); i += HEADERS_POW_BATCH_SIZE) {
+        vChecks.emplace_back(&headers[i], std::min(HEADERS_POW_BATCH_SIZE, headers.size() - i), &hashes[i], consensusParams);
+    }
+    if (nScriptCheckThreads) {
+        // Workers take checks from the back of the queue: add them last to first
+        // so the earliest headers are checked first. Once one fails, the
+        // remaining checks are skipped, which bounds the work an invalid header costs.
+        std::reverse(vChecks.begin(), vChecks.end());
+        CCheckQueueControl<CHeaderPoWCheck> control(&headerpowcheckqueue);
+        control.Add(vChecks);
+        return control.Wait();
+    }
+    for (CHeaderPoWCheck& check : vChecks) {
+        if (!check())
+            return false;
+    }
+    return true;
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2573,8 +2882,6 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     GetMainSignals().BlockDisconnected(pblock);
-    // Add mempool stats sample
-    CStats::DefaultStats()->addMempoolSample(mempool.size(), mempool.DynamicMemoryUsage(), mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK());
     return true;
 }
 
@@ -2662,10 +2969,13 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
-            return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
+        // The block may have been read ahead, along with the coins it spends
+        if (!g_block_prefetcher || !g_block_prefetcher->Take(pindexNew->GetBlockHash(), pthisBlock, *pcoinsTip)) {
+            std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockNew, pindexNew, chainparams.GetConsensus()))
+                return AbortNode(state, "Failed to read block");
+            pthisBlock = pblockNew;
+        }
     } else {
         pthisBlock = pblock;
     }
@@ -2702,9 +3012,6 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     chainActive.SetTip(pindexNew);
     UpdateTip(pindexNew, chainparams);
 
-    // Add mempool stats sample
-    CStats::DefaultStats()->addMempoolSample(mempool.size(), mempool.DynamicMemoryUsage(), mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK());
-
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
@@ -2783,6 +3090,24 @@ void CChainState::PruneBlockIndexCandidates() {
     assert(!setBlockIndexCandidates.empty());
 }
 
+/**
+ * Have the block prefetcher read ahead the blocks of vpindexToConnect, which
+ * holds them in reverse order, during initial block download. pindexSkip is a
+ * block that is already in memory.
+ */
+static void PrefetchBlocks(const std::vector<CBlockIndex*>& vpindexToConnect, const CBlockIndex* pindexSkip)
+{
+    std::vector<CBlockPrefetcher::Request> vRequests;
+    if (IsInitialBlockDownload()) {
+        vRequests.reserve(vpindexToConnect.size());
+        for (const CBlockIndex* pindex : reverse_iterate(vpindexToConnect)) {
+            if (pindex != pindexSkip && (pindex->nStatus & BLOCK_HAVE_DATA))
+                vRequests.push_back(CBlockPrefetcher::Request{pindex->GetBlockHash(), pindex->GetBlockPos(), pindex->hashPoW});
+        }
+    }
+    g_block_prefetcher->Prefetch(vRequests);
+}
+
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either nullptr or a pointer to a CBlock corresponding to pindexMostWork.
@@ -2824,6 +3149,9 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        if (g_block_prefetcher)
+            PrefetchBlocks(vpindexToConnect, pblock ? pindexMostWork : nullptr);
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -3300,16 +3628,22 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, uint256* phashPoW = nullptr)
 {
-    // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
-        return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+    // Check proof of work matches claimed amount. A non-null *phashPoW is
+    // taken to be the already computed scrypt hash of this header.
+    if (fCheckPOW) {
+        const uint256 hashPoW = (phashPoW && !phashPoW->IsNull()) ? *phashPoW : block.GetPoWHash();
+        if (!CheckProofOfWork(hashPoW, block.nBits, consensusParams))
+            return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+        if (phashPoW)
+            *phashPoW = hashPoW;
+    }
 
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, uint256* phashPoW)
 {
     // These are checks that are independent of context.
 
@@ -3318,7 +3652,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW, phashPoW))
         return false;
 
     // Check the merkle root.
@@ -3573,13 +3907,14 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashPoW)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
     uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
+    uint256 hashPoW = phashPoW ? *phashPoW : uint256();
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
 
         if (miSelf != mapBlockIndex.end()) {
@@ -3592,7 +3927,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), true, &hashPoW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3621,8 +3956,11 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
+        if (pindex->hashPoW.IsNull() && !hashPoW.IsNull())
+            pindex->hashPoW = hashPoW;
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -3636,11 +3974,37 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Hash the headers we don't know yet outside of cs_main, in batches so the
+    // multi-buffer scrypt kernels can work on several of them at once, spread
+    // over the header PoW check threads when there are any.
+    std::vector<CBlockHeader> unknown;
+    std::vector<size_t> unknown_pos;
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (!mapBlockIndex.count(headers[i].GetHash())) {
+                unknown.push_back(headers[i]);
+                unknown_pos.push_back(i);
+            }
+        }
+    }
+    // A failure leaves later entries null; AcceptBlockHeader rejects the
+    // message at the failing header and hashes any null entry before it.
+    std::vector<uint256> unknown_pow;
+    CheckHeadersPoW(unknown, unknown_pow, chainparams.GetConsensus());
+
+    {
+        LOCK(cs_main);
+        size_t next_unknown = 0;
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            const uint256* phashPoW = nullptr;
+            if (next_unknown < unknown_pos.size() && unknown_pos[next_unknown] == i) {
+                phashPoW = &unknown_pow[next_unknown++];
+            }
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, phashPoW)) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3673,7 +4037,7 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
 }
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
-bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phashPoW)
 {
     const CBlock& block = *pblock;
 
@@ -3683,7 +4047,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, phashPoW))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -3865,6 +4229,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        g_block_file_reader.Forget(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4135,6 +4500,19 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // Address indexes created before the per-address summaries existed
+    // need them built once from the deltas
+    if (fAddressIndex) {
+        bool fAddressSummaries = false;
+        pblocktree->ReadFlag("addresssummaries", fAddressSummaries);
+        if (!fAddressSummaries) {
+            LogPrintf("%s: building address summaries...\n", __func__);
+            if (!pblocktree->BuildAddressSummaries())
+                return error("%s: failed to build address summaries", __func__);
+            pblocktree->WriteFlag("addresssummaries", true);
+        }
+    }
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
@@ -4537,6 +4915,7 @@ bool LoadBlockIndex(const CChainParams& chainparams)
 	    // Use the provided setting for -addressindex in the new database
         fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
         pblocktree->WriteFlag("addressindex", fAddressIndex);
+        pblocktree->WriteFlag("addresssummaries", fAddressIndex);
 
         // Use the provided setting for -timestampindex in the new database
         fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -4580,21 +4959,155 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+namespace {
+
+/**
+ * Pipeline behind LoadExternalBlockFile. A scan thread locates the blocks in
+ * the file and reads their bytes, a pool of worker threads deserializes them
+ * and runs the context-free checks, which are dominated by the scrypt hash of
+ * the header, and the calling thread takes them back in file order to accept
+ * them one at a time.
+ *
+ * A record that doesn't deserialize may hide a block, so as in a serial
+ * scan the file is scanned again from one byte past its start. The blocks
+ * read after it are dropped, and found again by that scan.
+ */
+class CBlockImportPipeline
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
+public:
+    struct Item
+    {
+        //! Position of the block in the file, just past its size prefix
+        CDiskBlockPos pos;
+        unsigned int nSize = 0;
+        //! Where to scan again if the block can't be deserialized: one byte into its header
+        uint64_t nRescanPos = 0;
+        //! Serialized block, released once it has been deserialized
+        std::vector<unsigned char> data;
+        //! Null if the block could not be deserialized, see strError
+        std::shared_ptr<CBlock> pblock;
+        //! Scrypt hash of the header, or null unless the block passed CheckBlock
+        uint256 hashPoW;
+        std::string strError;
+        bool fDone = false;
+    };
 
-    int nLoaded = 0;
+    CBlockImportPipeline(const CChainParams& chainparams, FILE* fileIn, int nFile, int nThreads);
+    ~CBlockImportPipeline();
+
+    /** Wait for the next block in file order to be checked, false once the file is exhausted */
+    bool Next(std::shared_ptr<Item>& item);
+    /** Error that ended the scan early, if any */
+    std::string GetScanError();
+
+private:
+    const CChainParams& chainparams;
+
+    std::mutex cs;
+    //! Signalled when the scan thread may read further ahead
+    std::condition_variable condScan;
+    //! Signalled when a block is waiting for a worker
+    std::condition_variable condWork;
+    //! Signalled when a block is done or the scan is over
+    std::condition_variable condDone;
+
+    // Guarded by cs
+    //! Blocks read from the file and not yet taken by Next, in file order
+    std::deque<std::shared_ptr<Item>> queue;
+    //! Position in queue of the first block no worker has taken yet
+    size_t nNextWork;
+    //! Position of the scan in the file
+    uint64_t nScanPos;
+    //! Set when the scan must start again from nResyncPos
+    bool fResync;
+    uint64_t nResyncPos;
+    bool fScanDone;
+    bool fStop;
+    std::string strScanError;
+
+    std::thread threadScan;
+    std::vector<std::thread> threadsWork;
+
+    void ThreadScan(FILE* fileIn, int nFile);
+    void ThreadWork();
+};
+
+CBlockImportPipeline::CBlockImportPipeline(const CChainParams& chainparamsIn, FILE* fileIn, int nFile, int nThreads) :
+    chainparams(chainparamsIn), nNextWork(0), nScanPos(0), fResync(false), nResyncPos(0), fScanDone(false), fStop(false)
+{
+    threadScan = std::thread(&TraceThread<std::function<void()> >, "loadblkscan", std::function<void()>(std::bind(&CBlockImportPipeline::ThreadScan, this, fileIn, nFile)));
+    for (int i = 0; i < nThreads; i++) {
+        threadsWork.emplace_back(&TraceThread<std::function<void()> >, "loadblkcheck", std::function<void()>(std::bind(&CBlockImportPipeline::ThreadWork, this)));
+    }
+}
+
+CBlockImportPipeline::~CBlockImportPipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStop = true;
+    }
+    condScan.notify_all();
+    condWork.notify_all();
+    threadScan.join();
+    for (std::thread& thread : threadsWork)
+        thread.join();
+}
+
+bool CBlockImportPipeline::Next(std::shared_ptr<Item>& item)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    condDone.wait(lock, [this] { return (!queue.empty() && queue.front()->fDone) || (queue.empty() && fScanDone); });
+    if (queue.empty())
+        return false;
+    item = std::move(queue.front());
+    queue.pop_front();
+    nNextWork--;
+    condScan.notify_one();
+    return true;
+}
+
+std::string CBlockImportPipeline::GetScanError()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return strScanError;
+}
+
+void CBlockImportPipeline::ThreadScan(FILE* fileIn, int nFile)
+{
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
+        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor.
+        // Besides the read ahead it can rewind over the block being read and
+        // the one read after a resync was requested, so the scan can always
+        // go back to a queued block.
+        const uint64_t nRewindSize = MAX_IMPORT_READAHEAD_BYTES + 2*(MAX_BLOCK_SERIALIZED_SIZE+8);
+        CBufferedFile blkdat(fileIn, nRewindSize + MAX_BLOCK_SERIALIZED_SIZE, nRewindSize, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+        while (true) {
+            {
+                // Always allow one block in, however large it is. At the end
+                // of the file, wait for the queued blocks to be deserialized,
+                // as one of them may still need the scan to start again.
+                std::unique_lock<std::mutex> lock(cs);
+                condScan.wait(lock, [this, &blkdat] {
+                    if (fStop || fResync)
+                        return true;
+                    if (blkdat.eof())
+                        return std::all_of(queue.begin(), queue.end(), [](const std::shared_ptr<Item>& item) { return item->fDone; });
+                    return queue.empty() || nScanPos - (queue.front()->nRescanPos - 1) < MAX_IMPORT_READAHEAD_BYTES;
+                });
+                if (fStop)
+                    break;
+                if (fResync) {
+                    fResync = false;
+                    nRewind = nResyncPos;
+                } else if (blkdat.eof()) {
+                    break;
+                }
+            }
 
-            blkdat.SetPos(nRewind);
+            if (!blkdat.SetPos(nRewind))
+                LogPrintf("LoadExternalBlockFile: Unable to rewind to position %u, scanning on from %u\n", nRewind, blkdat.GetPos());
             nRewind++; // start one byte further next time, in case of failure
             blkdat.SetLimit(); // remove former limit
             unsigned int nSize = 0;
@@ -4612,19 +5125,121 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                     continue;
             } catch (const std::exception&) {
                 // no valid block header found; don't complain
+                if (blkdat.eof())
+                    continue;
                 break;
             }
+            std::shared_ptr<Item> item = std::make_shared<Item>();
             try {
                 // read block
                 uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
+                item->pos = CDiskBlockPos(nFile, nBlockPos);
+                item->nSize = nSize;
+                item->nRescanPos = nRewind;
                 blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
+                item->data.resize(nSize);
+                blkdat.read((char*)item->data.data(), nSize);
                 nRewind = blkdat.GetPos();
+            } catch (const std::exception& e) {
+                LogPrintf("LoadExternalBlockFile: Deserialize or I/O error - %s\n", e.what());
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(cs);
+            // After a resync this block is part of the scan again
+            if (fResync)
+                continue;
+            queue.push_back(std::move(item));
+            nScanPos = nRewind;
+            condWork.notify_one();
+        }
+    } catch (const std::runtime_error& e) {
+        std::lock_guard<std::mutex> lock(cs);
+        strScanError = e.what();
+    }
+
+    std::lock_guard<std::mutex> lock(cs);
+    fScanDone = true;
+    condDone.notify_all();
+}
+
+void CBlockImportPipeline::ThreadWork()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        condWork.wait(lock, [this] { return fStop || nNextWork < queue.size(); });
+        if (fStop)
+            return;
+        std::shared_ptr<Item> item = queue[nNextWork++];
+        lock.unlock();
+
+        try {
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            CSpanReader(SER_DISK, CLIENT_VERSION, item->data.data(), item->data.data() + item->data.size()) >> *pblock;
+            item->pblock = std::move(pblock);
+        } catch (const std::exception& e) {
+            item->strError = e.what();
+        }
+        std::vector<unsigned char>().swap(item->data);
+        if (item->pblock) {
+            // A block that passes is marked as checked, so AcceptBlock
+            // doesn't repeat the checks. One that fails is left for
+            // AcceptBlock to reject.
+            CValidationState state;
+            CheckBlock(*item->pblock, state, chainparams.GetConsensus(), true, true, &item->hashPoW);
+        }
+
+        lock.lock();
+        if (!item->pblock) {
+            // Unless an earlier failure dropped it already, drop everything
+            // read after the block and scan again from inside it
+            std::deque<std::shared_ptr<Item>>::iterator it = std::find(queue.begin(), queue.end(), item);
+            if (it != queue.end()) {
+                size_t nKeep = it - queue.begin() + 1;
+                queue.erase(queue.begin() + nKeep, queue.end());
+                nNextWork = std::min(nNextWork, nKeep);
+                fResync = true;
+                nResyncPos = item->nRescanPos;
+                nScanPos = nResyncPos;
+            }
+        }
+        item->fDone = true;
+        condDone.notify_all();
+        condScan.notify_one();
+    }
+}
+
+} // namespace
+
+bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+{
+    // Map of disk positions for blocks with unknown parent (only used for reindex)
+    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    int64_t nStart = GetTimeMillis();
+
+    int nThreads = gArgs.GetArg("-importthreads", DEFAULT_IMPORT_THREADS);
+    if (nThreads <= 0)
+        nThreads = GetNumCores();
+    nThreads = std::max(1, std::min(nThreads, MAX_IMPORT_THREADS));
+
+    int nLoaded = 0;
+    try {
+        CBlockImportPipeline pipeline(chainparams, fileIn, dbp ? dbp->nFile : 0, nThreads);
+        std::shared_ptr<CBlockImportPipeline::Item> item;
+        while (true) {
+            boost::this_thread::interruption_point();
+
+            if (!pipeline.Next(item))
+                break;
+            if (!item->pblock) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, item->strError);
+                continue;
+            }
+            try {
+                if (dbp)
+                    dbp->nPos = item->pos.nPos;
+                std::shared_ptr<CBlock> pblock = item->pblock;
+                CBlock& block = *pblock;
 
                 // detect out of order blocks, and store them for later
                 uint256 hash = block.GetHash();
@@ -4640,7 +5255,7 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
                     LOCK(cs_main);
                     CValidationState state;
-                    if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
+                    if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr, &item->hashPoW))
                         nLoaded++;
                     if (state.IsError())
                         break;
@@ -4689,6 +5304,9 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
+        std::string strScanError = pipeline.GetScanError();
+        if (!strScanError.empty())
+            throw std::runtime_error(strScanError);
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -4913,10 +5531,141 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+/**
+ * Accept transactions read from disk to the mempool, in batches that each
+ * take cs_main once. Transactions whose parents come later are retried, in
+ * batches as well, after all batches have been accepted.
+ */
+static bool ImportMempool(const CChainParams& chainparams, std::vector<MempoolDiskEntry>& entries, const std::map<uint256, CAmount>& mapDeltas)
+{
+    int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    int64_t count = 0;
+    int64_t expired = 0;
+    int64_t failed = 0;
+    int64_t already_there = 0;
+    int64_t nNow = GetTime();
+
+    std::vector<CTransactionRef> vtx;
+    std::vector<int64_t> vTime;
+    std::vector<CTransactionRef> vtxMissing;
+    std::vector<int64_t> vTimeMissing;
+    auto accept = [&]() {
+        std::vector<CValidationState> vState;
+        std::vector<bool> vMissingInputs;
+        std::vector<bool> vAccepted(vtx.size());
+        {
+            LOCK(cs_main);
+            std::vector<COutPoint> coins_to_uncache;
+            PrefetchMempoolInputs(vtx, coins_to_uncache);
+            AcceptToMemoryPoolBatchWithTime(chainparams, mempool, vtx, vTime, vState, vMissingInputs, nullptr /* plTxnReplaced */, 0 /* nAbsurdFee */);
+
+            // Keep the inputs of transactions that are in the mempool now
+            // cached, as AcceptToMemoryPool would have
+            std::set<COutPoint> setKeep;
+            for (size_t i = 0; i < vtx.size(); i++) {
+                vAccepted[i] = mempool.exists(vtx[i]->GetHash());
+                if (!vAccepted[i])
+                    continue;
+                for (const CTxIn& txin : vtx[i]->vin)
+                    setKeep.insert(txin.prevout);
+            }
+            for (const COutPoint& outpoint : coins_to_uncache) {
+                if (!setKeep.count(outpoint))
+                    pcoinsTip->Uncache(outpoint);
+            }
+        }
+        for (size_t i = 0; i < vtx.size(); i++) {
+            if (vAccepted[i]) {
+                // mempool may contain the transaction already, e.g. from
+                // wallet(s) having loaded it while we were processing
+                // mempool transactions; consider these as valid, instead of
+                // failed, but mark them as 'already there'
+                if (vState[i].GetRejectReason() == "txn-already-in-mempool") {
+                    ++already_there;
+                } else {
+                    ++count;
+                }
+            } else if (vMissingInputs[i]) {
+                vtxMissing.push_back(vtx[i]);
+                vTimeMissing.push_back(vTime[i]);
+            } else {
+                ++failed;
+            }
+        }
+        vtx.clear();
+        vTime.clear();
+    };
+
+    for (MempoolDiskEntry& entry : entries) {
+        if (entry.nFeeDelta) {
+            mempool.PrioritiseTransaction(entry.tx->GetHash(), entry.nFeeDelta);
+        }
+        if (entry.nTime + nExpiryTimeout > nNow) {
+            vtx.push_back(std::move(entry.tx));
+            vTime.push_back(entry.nTime);
+        } else {
+            ++expired;
+        }
+        if (vtx.size() == MEMPOOL_LOAD_BATCH_SIZE) {
+            accept();
+            if (ShutdownRequested())
+                return false;
+        }
+    }
+    accept();
+
+    // Retry the transactions with missing inputs for as long as that gets
+    // some of them in, as their parents may be further on in the retry
+    while (!vtxMissing.empty()) {
+        std::vector<CTransactionRef> vtxRetry;
+        std::vector<int64_t> vTimeRetry;
+        vtxRetry.swap(vtxMissing);
+        vTimeRetry.swap(vTimeMissing);
+        for (size_t i = 0; i < vtxRetry.size(); i++) {
+            vtx.push_back(std::move(vtxRetry[i]));
+            vTime.push_back(vTimeRetry[i]);
+            if (vtx.size() == MEMPOOL_LOAD_BATCH_SIZE || i + 1 == vtxRetry.size()) {
+                accept();
+                if (ShutdownRequested())
+                    return false;
+            }
+        }
+        if (vtxMissing.size() == vtxRetry.size()) {
+            failed += vtxMissing.size();
+            break;
+        }
+    }
+
+    for (const auto& i : mapDeltas) {
+        mempool.PrioritiseTransaction(i.first, i.second);
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    return true;
+}
+
 bool LoadMempool(void)
 {
     const CChainParams& chainparams = Params();
-    int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    std::vector<MempoolDiskEntry> entries;
+    std::map<uint256, CAmount> mapDeltas;
+
+    // A journal left by -mempooljournal is always newer than mempool.dat
+    fs::path pathJournal = GetDataDir() / MEMPOOL_JOURNAL_FILENAME;
+    if (fs::exists(pathJournal)) {
+        if (!CMempoolJournal::Read(pathJournal, entries, mapDeltas)) {
+            LogPrintf("Failed to read mempool journal from disk. Continuing anyway.\n");
+            return false;
+        }
+        if (!ImportMempool(chainparams, entries, mapDeltas))
+            return false;
+        if (!gArgs.GetBoolArg("-mempooljournal", DEFAULT_MEMPOOL_JOURNAL)) {
+            // The mempool is dumped to mempool.dat at shutdown again
+            fs::remove(pathJournal);
+        }
+        return true;
+    }
+
     FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
     CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
     if (file.IsNull()) {
@@ -4924,12 +5673,6 @@ bool LoadMempool(void)
         return false;
     }
 
-    int64_t count = 0;
-    int64_t expired = 0;
-    int64_t failed = 0;
-    int64_t already_there = 0;
-    int64_t nNow = GetTime();
-
     try {
         uint64_t version;
         file >> version;
@@ -4939,54 +5682,17 @@ bool LoadMempool(void)
         uint64_t num;
         file >> num;
         while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
-            }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (mempool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
-                    }
-                }
-            } else {
-                ++expired;
-            }
-            if (ShutdownRequested())
-                return false;
+            MempoolDiskEntry entry;
+            file >> entry;
+            entries.push_back(std::move(entry));
         }
-        std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
-
-        for (const auto& i : mapDeltas) {
-            mempool.PrioritiseTransaction(i.first, i.second);
-        }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
-    return true;
+    return ImportMempool(chainparams, entries, mapDeltas);
 }
 
 bool DumpMempool(void)
@@ -5038,6 +5744,124 @@ bool DumpMempool(void)
     return true;
 }
 
+static const uint64_t COINS_SNAPSHOT_VERSION = 1;
+static const char* const COINS_SNAPSHOT_FILENAME = "coinscache.dat";
+
+/**
+ * The snapshot file holds the version, the best block the coins belong to,
+ * the number of coins and the coins themselves in their chainstate
+ * encoding, followed by a double-SHA256 of everything before it.
+ */
+bool DumpCoinsCacheSnapshot()
+{
+    int64_t nStart = GetTimeMicros();
+    uint64_t nCoins = 0;
+
+    try {
+        FILE* filestr = fsbridge::fopen(GetDataDir() / "coinscache.dat.new", "wb");
+        if (!filestr) {
+            return false;
+        }
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+
+        LOCK(cs_main);
+        const uint256 hashBestBlock = pcoinsTip->GetBestBlock();
+        pcoinsTip->ForEachCachedCoin([&nCoins](const COutPoint&, const Coin&) { nCoins++; });
+
+        uint64_t version = COINS_SNAPSHOT_VERSION;
+        file << version << hashBestBlock << nCoins;
+        hasher << version << hashBestBlock << nCoins;
+        pcoinsTip->ForEachCachedCoin([&file, &hasher](const COutPoint& outpoint, const Coin& coin) {
+            file << outpoint << coin;
+            hasher << outpoint << coin;
+        });
+        file << hasher.GetHash();
+
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "coinscache.dat.new", GetDataDir() / COINS_SNAPSHOT_FILENAME);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump coins cache: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    LogPrintf("Dumped coins cache: %u coins in %gs\n", nCoins, (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
+bool LoadCoinsCacheSnapshot()
+{
+    int64_t nStart = GetTimeMicros();
+    const fs::path path = GetDataDir() / COINS_SNAPSHOT_FILENAME;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return false;
+        }
+        // Read the whole file in one go and verify it before looking at any
+        // of its contents: the coins go into pcoinsTip as if read from the
+        // coins database, so a damaged file must never get that far.
+        try {
+            const uint64_t nSize = fs::file_size(path);
+            if (nSize < sizeof(uint256)) {
+                throw std::ios_base::failure("file too short");
+            }
+            ss.resize(nSize);
+            file.read(ss.data(), nSize);
+        } catch (const std::exception& e) {
+            LogPrintf("Failed to read coins cache snapshot: %s. Continuing anyway.\n", e.what());
+            return false;
+        }
+    }
+    // A snapshot is only used once; the cache is written out afresh on the
+    // next clean shutdown.
+    fs::remove(path);
+
+    const uint256 hashStored(std::vector<unsigned char>(ss.end() - sizeof(uint256), ss.end()));
+    ss.resize(ss.size() - sizeof(uint256));
+    if (Hash(ss.begin(), ss.end()) != hashStored) {
+        LogPrintf("Coins cache snapshot is corrupt. Continuing anyway.\n");
+        return false;
+    }
+
+    uint64_t nLoaded = 0;
+    uint64_t nCoins = 0;
+    try {
+        uint64_t version;
+        uint256 hashBestBlock;
+        ss >> version >> hashBestBlock >> nCoins;
+        if (version != COINS_SNAPSHOT_VERSION) {
+            return false;
+        }
+
+        LOCK(cs_main);
+        // Cached coins must match the coins database, so the snapshot is only
+        // of use if nothing has been written to the database since.
+        if (hashBestBlock != pcoinsdbview->GetBestBlock()) {
+            LogPrintf("Coins cache snapshot is for block %s, not the current best block. Ignoring it.\n", hashBestBlock.ToString());
+            return false;
+        }
+        // Leave room for new blocks, so the first one doesn't immediately
+        // trigger a full flush of what was just loaded.
+        const size_t nMaxUsage = nCoinCacheUsage / 4 * 3;
+        for (uint64_t i = 0; i < nCoins && pcoinsTip->DynamicMemoryUsage() < nMaxUsage; i++) {
+            COutPoint outpoint;
+            Coin coin;
+            ss >> outpoint >> coin;
+            if (!coin.IsSpent() && pcoinsTip->PreloadCoin(outpoint, std::move(coin))) {
+                nLoaded++;
+            }
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize coins cache snapshot: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Loaded coins cache snapshot: %u of %u coins in %gs\n", nLoaded, nCoins, (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
     if (pindex == nullptr)
@@ -25,6 +25,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -40,6 +41,7 @@ class CBlockTreeDB;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
+class CRawBlock;
 class CConnman;
 class CScriptCheck;
 class CBlockPolicyEstimator;
@@ -85,6 +87,16 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads deserializing and checking blocks during -reindex and -loadblock */
+static const int MAX_IMPORT_THREADS = 16;
+/** -importthreads default (0 = one per core) */
+static const int DEFAULT_IMPORT_THREADS = 0;
+/** Bytes of the block file read ahead of the oldest block not yet accepted during -reindex and -loadblock */
+static const size_t MAX_IMPORT_READAHEAD_BYTES = 16 * 1000 * 1000;
+/** Number of transactions read from disk that are accepted to the mempool at a time */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+/** Default for -mempoolparallelinputs */
+static const unsigned int DEFAULT_MEMPOOL_PARALLEL_INPUTS = 32;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -92,6 +104,8 @@ static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 2000;
+/** Number of unknown headers whose scrypt PoW is computed together in ProcessNewBlockHeaders. */
+static const size_t HEADERS_POW_BATCH_SIZE = 16;
 /** Maximum depth of blocks we're willing to serve as compact blocks to peers
  *  when requested. For older blocks, a regular BLOCK response will be sent. */
 static const int MAX_CMPCTBLOCK_DEPTH = 5;
@@ -141,6 +155,8 @@ static const bool DEFAULT_SPENTINDEX = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -dbcachesnapshot */
+static const bool DEFAULT_DBCACHE_SNAPSHOT = false;
 /** Default for -mempoolreplacement */
 static const bool DEFAULT_ENABLE_REPLACEMENT = false;
 /** Default for using fee filter */
@@ -177,6 +193,7 @@ extern uint256 hashBestBlock;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern unsigned int nMempoolParallelInputs;
 extern bool fAddressIndex;
 extern bool fSpentIndex;
 extern bool fTimestampIndex;
@@ -184,6 +201,8 @@ extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
+/** Recompute and check the scrypt PoW of every block index entry when loading it at startup. */
+extern bool fCheckBlockIndexPoW;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
@@ -220,6 +239,7 @@ static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6 * 4;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+static const bool DEFAULT_CHECKBLOCKINDEXPOW = false;
 
 // Require that user allocate at least 550MB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -284,6 +304,14 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadHeaderPoWCheck();
+/**
+ * Compute the scrypt hashes of headers into hashes and check them against each
+ * header's nBits, on the header PoW check threads if there are any. Returns
+ * false if any check failed, in which case some hashes may be left null.
+ */
+bool CheckHeadersPoW(const std::vector<CBlockHeader>& headers, std::vector<uint256>& hashes, const Consensus::Params& consensusParams);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -321,6 +349,14 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee);
 
+/** (try to) add a batch of transactions to memory pool under a single lock,
+ * trimming the mempool and flushing the coins cache once for the whole batch.
+ * Transactions may spend outputs of others in the batch, in any order.
+ * vState and vMissingInputs receive the result of each transaction; returns
+ * true if all of them were accepted. **/
+bool AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx, std::vector<CValidationState>& vState,
+                             std::vector<bool>& vMissingInputs, std::list<CTransactionRef>* plTxnReplaced, const CAmount nAbsurdFee);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -412,15 +448,24 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Stream address index entries into fn, resuming after pAfter if given, until fn returns false */
+bool GetAddressIndex(uint160 addressHash, int type, const CAddressIndexKey* pAfter, int start, int end,
+                     const std::function<bool(const CAddressIndexKey&, CAmount)>& fn);
+bool GetAddressUnspent(uint160 addressHash, int type, const CAddressUnspentKey* pAfter,
+                       const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)>& fn);
+/** Read the running totals of an address; a null summary means no history */
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary);
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** The block as stored on disk, without deserializing it */
+bool ReadRawBlockFromDisk(CRawBlock& raw, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
-/** Context-independent validity checks */
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
+/** Context-independent validity checks. A non-null phashPoW receives the scrypt hash of the header once it is checked. */
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, uint256* phashPoW = nullptr);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
@@ -503,4 +548,10 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Write the unspent coins held in pcoinsTip to disk, for LoadCoinsCacheSnapshot on the next start. */
+bool DumpCoinsCacheSnapshot();
+
+/** Fill pcoinsTip from the snapshot on disk, if it was taken at the coins database's best block. */
+bool LoadCoinsCacheSnapshot();
+
 #endif // BITCOIN_VALIDATION_H